@@ -3,33 +3,39 @@
 
 #include "bitmap.h"
 
+/*
+ * The searches below work a word at a time, the bit we are after in a
+ * word is found with count-trailing-zeros (cntlzd/cnttzd).
+ */
+
+/* Word el of the map with the bits we are looking for set */
+static inline bitmap_elem_t __bitmap_elem(bitmap_t map, unsigned int el,
+					  bool value)
+{
+	return value ? map[el] : ~map[el];
+}
+
 static int __bitmap_find_bit(bitmap_t map, unsigned int start, unsigned int count,
 			     bool value)
 {
-	unsigned int el, first_bit;
-	unsigned int end = start + count;
-	bitmap_elem_t e, ev;
-	int b;
+	unsigned int el, end = start + count;
+	bitmap_elem_t e;
+	unsigned int b;
+
+	if (!count)
+		return -1;
 
-	ev = value ? -1ul : 0;
 	el = BITMAP_ELEM(start);
-	first_bit = BITMAP_BIT(start);
-
-	while (start < end) {
-		e = map[el] ^ ev;
-		e |= ((1ul << first_bit) - 1);
-		if (~e)
-			break;
-		start = (start + BITMAP_ELSZ) & ~(BITMAP_ELSZ - 1);
-		first_bit = 0;
+	e = __bitmap_elem(map, el, value) & (-1ul << BITMAP_BIT(start));
+	while (!e) {
 		el++;
+		if (el * BITMAP_ELSZ >= end)
+			return -1;
+		e = __bitmap_elem(map, el, value);
 	}
-	for (b = first_bit; b < BITMAP_ELSZ && start < end; b++,start++) {
-		if ((e & (1ull << b)) == 0)
-			return start;
-	}
+	b = el * BITMAP_ELSZ + __builtin_ctzl(e);
 
-	return -1;
+	return b < end ? (int)b : -1;
 }
 
 int bitmap_find_zero_bit(bitmap_t map, unsigned int start, unsigned int count)
@@ -41,4 +47,3 @@ int bitmap_find_one_bit(bitmap_t map, unsigned int start, unsigned int count)
 {
 	return __bitmap_find_bit(map, start, count, true);
 }
-
@@ -50,6 +50,46 @@ static inline unsigned int buddy_node_to_index(struct buddy *b,
 	return (node - start) << order;
 }
 
+static inline unsigned int buddy_summary_size(struct buddy *b)
+{
+	return BITMAP_ELEMS(buddy_map_size(b));
+}
+
+/* Node state changes go through these to keep the summary in sync */
+static inline void buddy_set_busy(struct buddy *b, unsigned int node)
+{
+	bitmap_set_bit(b->map, node);
+	if (!~b->map[BITMAP_ELEM(node)])
+		bitmap_clr_bit(b->summary, BITMAP_ELEM(node));
+}
+
+static inline void buddy_set_free(struct buddy *b, unsigned int node)
+{
+	bitmap_clr_bit(b->map, node);
+	bitmap_set_bit(b->summary, BITMAP_ELEM(node));
+}
+
+static int buddy_find_free(struct buddy *b, unsigned int order)
+{
+	unsigned int start = buddy_order_start(b, order);
+	unsigned int count = 1u << (b->max_order - order);
+	int el;
+
+	/* The small levels all share the first word of the map */
+	if (count < BITMAP_ELSZ)
+		return bitmap_find_zero_bit(b->map, start, count);
+
+	/* The others are made of whole words, find one with a free
+	 * node in the summary first, then the node in that word.
+	 */
+	el = bitmap_find_one_bit(b->summary, BITMAP_ELEM(start),
+				 BITMAP_ELEM(count));
+	if (el < 0)
+		return -1;
+
+	return bitmap_find_zero_bit(b->map, el * BITMAP_ELSZ, BITMAP_ELSZ);
+}
+
 #ifdef BUDDY_DEBUG
 static void buddy_check_alloc(struct buddy *b, unsigned int node)
 {
@@ -101,14 +141,13 @@ int buddy_alloc(struct buddy *b, unsigned int order)
 		    1u << (b->max_order - o));
 
 	/* Now find a free node */
-	node = bitmap_find_zero_bit(b->map, buddy_order_start(b, o),
-				    1u << (b->max_order - o));
+	node = buddy_find_free(b, o);
 
 	/* There should always be one */
 	assert(node >= 0);
 
 	/* Mark it allocated and decrease free count */
-	bitmap_set_bit(b->map, node);
+	buddy_set_busy(b, node);
 	b->freecounts[o]--;
 
 	/* We know that node was free which means all its children must have
@@ -128,7 +167,7 @@ int buddy_alloc(struct buddy *b, unsigned int order)
 
 		BUDDY_NOISE("  order %d, using %d marking %d free\n",
 			    o, node, node ^ 1);
-		bitmap_clr_bit(b->map, node ^ 1);
+		buddy_set_free(b, node ^ 1);
 		b->freecounts[o]++;
 		assert(bitmap_tst_bit(b->map, node));
 	}
@@ -166,7 +205,7 @@ bool buddy_reserve(struct buddy *b, unsigned int index, unsigned int order)
 		return false;
 
 	/* We sit on a free node, mark it busy */
-	bitmap_set_bit(b->map, freenode);
+	buddy_set_busy(b, freenode);
 	assert(b->freecounts[o]);
 	b->freecounts[o]--;
 
@@ -187,7 +226,7 @@ bool buddy_reserve(struct buddy *b, unsigned int index, unsigned int order)
 
 		BUDDY_NOISE("  order %d, using %d marking %d free\n",
 			    o, freenode, freenode ^ 1);
-		bitmap_clr_bit(b->map, freenode ^ 1);
+		buddy_set_free(b, freenode ^ 1);
 		b->freecounts[o]++;
 		assert(bitmap_tst_bit(b->map, node));
 	}
@@ -223,7 +262,7 @@ void buddy_free(struct buddy *b, unsigned int index, unsigned int order)
 			    order, node, node ^ 1);
 
 		/* Mark buddy busy (we are already marked busy) */
-		bitmap_set_bit(b->map, node ^ 1);
+		buddy_set_busy(b, node ^ 1);
 
 		/* Reduce free count */
 		assert(b->freecounts[order] > 0);
@@ -240,7 +279,7 @@ void buddy_free(struct buddy *b, unsigned int index, unsigned int order)
 	}
 
 	/* No more coalescing, mark it free */
-	bitmap_clr_bit(b->map, node);
+	buddy_set_free(b, node);
 
 	/* Increase the freelist count for that level */
 	b->freecounts[order]++;
@@ -256,6 +295,7 @@ void buddy_reset(struct buddy *b)
 	BUDDY_NOISE("buddy_reset()\n");
 	/* We fill the bitmap with 1's to make it completely "busy" */
 	memset(b->map, 0xff, bsize);
+	memset(b->summary, 0, BITMAP_BYTES(buddy_summary_size(b)));
 	memset(b->freecounts, 0, sizeof(b->freecounts));
 
 	/* We mark the root of the tree free, this is entry 1 as entry 0
@@ -273,10 +313,13 @@ struct buddy *buddy_create(unsigned int max_order)
 
 	bsize = BITMAP_BYTES(1u << (max_order + 1));
 
-	b = zalloc(sizeof(struct buddy) + bsize);
+	/* The summary lives right after the map */
+	b = zalloc(sizeof(struct buddy) + bsize +
+		   BITMAP_BYTES(BITMAP_ELEMS(1u << (max_order + 1))));
 	if (!b)
 		return NULL;
 	b->max_order = max_order;
+	b->summary = b->map + BITMAP_ELEMS(1u << (max_order + 1));
 
 	BUDDY_NOISE("Map @%p, size: %d bytes\n", b->map, bsize);
 
@@ -48,7 +48,6 @@ static struct dt_node *new_node(const char *name)
 	node->parent = NULL;
 	list_head_init(&node->properties);
 	list_head_init(&node->children);
-	/* FIXME: locking? */
 	node->phandle = new_phandle();
 	return node;
 }
@@ -34,6 +34,7 @@ struct flash {
 	uint64_t		size;
 	uint32_t		block_size;
 	int			id;
+	struct ffs_handle	*ffs;
 };
 
 static struct {
@@ -355,6 +356,39 @@ static int flash_nvram_probe(struct flash *flash, struct ffs_handle *ffs)
 	return 0;
 }
 
+/*
+ * Parse the TOC once and keep it. Each user still re-reads the raw
+ * TOC to check it hasn't changed, but doesn't parse the whole
+ * partition table and rebuild its index again. Writes and erases
+ * through OPAL also drop it.
+ */
+static struct ffs_handle *flash_get_ffs(struct flash *flash)
+{
+	int rc;
+
+	if (flash->ffs && ffs_toc_stale(flash->ffs)) {
+		ffs_close(flash->ffs);
+		flash->ffs = NULL;
+	}
+
+	if (!flash->ffs) {
+		rc = ffs_init(0, flash->size, flash->bl, &flash->ffs, 1);
+		if (rc) {
+			prerror("Can't open ffs handle: %d\n", rc);
+			flash->ffs = NULL;
+		}
+	}
+
+	return flash->ffs;
+}
+
+static void flash_put_ffs(struct flash *flash)
+{
+	if (flash->ffs)
+		ffs_close(flash->ffs);
+	flash->ffs = NULL;
+}
+
 /* core flash support */
 
 static struct dt_node *flash_add_dt_node(struct flash *flash, int id)
@@ -390,15 +424,10 @@ static struct dt_node *flash_add_dt_node(struct flash *flash, int id)
 	dt_add_property_cells(partition_container_node, "#size-cells", 2);
 
 	/* Add partitions */
-	for (i = 0, name = NULL; i < ARRAY_SIZE(part_name_map); i++) {
+	ffs = flash_get_ffs(flash);
+	for (i = 0, name = NULL; ffs && i < ARRAY_SIZE(part_name_map); i++) {
 		name = part_name_map[i].name;
 
-		rc = ffs_init(0, flash->size, flash->bl, &ffs, 1);
-		if (rc) {
-			prerror("Can't open ffs handle\n");
-			continue;
-		}
-
 		rc = ffs_lookup_part(ffs, name, &ffs_part_num);
 		if (rc) {
 			/* This is not an error per-se, some partitions
@@ -521,9 +550,10 @@ int flash_register(struct blocklevel_device *bl)
 	flash->size = size;
 	flash->block_size = block_size;
 	flash->id = num_flashes();
+	flash->ffs = NULL;
 
-	rc = ffs_init(0, flash->size, bl, &ffs, 1);
-	if (rc) {
+	ffs = flash_get_ffs(flash);
+	if (!ffs) {
 		/**
 		 * @fwts-label NoFFS
 		 * @fwts-advice System flash isn't formatted as expected.
@@ -532,16 +562,12 @@ int flash_register(struct blocklevel_device *bl)
 		 */
 		prlog(PR_WARNING, "No ffs info; "
 				"using raw device only\n");
-		ffs = NULL;
 	}
 
 	node = flash_add_dt_node(flash, flash->id);
 
 	setup_system_flash(flash, node, name, ffs);
 
-	if (ffs)
-		ffs_close(ffs);
-
 	lock(&flash_lock);
 	list_add(&flashes, &flash->list);
 	unlock(&flash_lock);
@@ -597,9 +623,11 @@ static int64_t opal_flash_op(enum flash_op op, uint64_t id, uint64_t offset,
 		rc = blocklevel_raw_read(flash->bl, offset, (void *)buf, size);
 		break;
 	case FLASH_OP_WRITE:
+		flash_put_ffs(flash);
 		rc = blocklevel_raw_write(flash->bl, offset, (void *)buf, size);
 		break;
 	case FLASH_OP_ERASE:
+		flash_put_ffs(flash);
 		rc = blocklevel_erase(flash->bl, offset, size);
 		break;
 	default:
@@ -770,11 +798,9 @@ static int flash_load_resource(enum resource_id id, uint32_t subid,
 		goto out_unlock;
 	}
 
-	rc = ffs_init(0, flash->size, flash->bl, &ffs, 1);
-	if (rc) {
-		prerror("Can't open ffs handle: %d\n", rc);
+	ffs = flash_get_ffs(flash);
+	if (!ffs)
 		goto out_unlock;
-	}
 
 	rc = ffs_lookup_part(ffs, name, &ffs_part_num);
 	if (rc) {
@@ -782,13 +808,13 @@ static int flash_load_resource(enum resource_id id, uint32_t subid,
 		 * are purposefully absent, don't spam the logs
 		 */
 	        prlog(PR_DEBUG, "No %s partition\n", name);
-		goto out_free_ffs;
+		goto out_unlock;
 	}
 	rc = ffs_part_info(ffs, ffs_part_num, NULL,
 			   &ffs_part_start, NULL, &ffs_part_size, &ecc);
 	if (rc) {
 		prerror("Failed to get %s partition info\n", name);
-		goto out_free_ffs;
+		goto out_unlock;
 	}
 	prlog(PR_DEBUG,"%s partition %s ECC\n",
 	      name, ecc  ? "has" : "doesn't have");
@@ -800,7 +826,7 @@ static int flash_load_resource(enum resource_id id, uint32_t subid,
 	if (ffs_part_size < SECURE_BOOT_HEADERS_SIZE) {
 		prerror("secboot headers bigger than "
 			"partition size 0x%x\n", ffs_part_size);
-		goto out_free_ffs;
+		goto out_unlock;
 	}
 
 	rc = blocklevel_read(flash->bl, ffs_part_start, bufp,
@@ -809,7 +835,7 @@ static int flash_load_resource(enum resource_id id, uint32_t subid,
 		prerror("failed to read the first 0x%x from "
 			"%s partition, rc %d\n", SECURE_BOOT_HEADERS_SIZE,
 			name, rc);
-		goto out_free_ffs;
+		goto out_unlock;
 	}
 
 	part_signed = stb_is_container(bufp, SECURE_BOOT_HEADERS_SIZE);
@@ -831,14 +857,14 @@ static int flash_load_resource(enum resource_id id, uint32_t subid,
 		if (content_size > bufsz) {
 			prerror("content size > buffer size\n");
 			rc = OPAL_PARAMETER;
-			goto out_free_ffs;
+			goto out_unlock;
 		}
 
 		if (*len > ffs_part_size) {
 			prerror("FLASH: Cannot load %s. Content is larger than the partition\n",
 					name);
 			rc = OPAL_PARAMETER;
-			goto out_free_ffs;
+			goto out_unlock;
 		}
 
 		ffs_part_start += SECURE_BOOT_HEADERS_SIZE;
@@ -849,7 +875,7 @@ static int flash_load_resource(enum resource_id id, uint32_t subid,
 			prerror("failed to read content size %d"
 				" %s partition, rc %d\n",
 				content_size, name, rc);
-			goto out_free_ffs;
+			goto out_unlock;
 		}
 
 		if (subid == RESOURCE_SUBID_NONE)
@@ -860,7 +886,7 @@ static int flash_load_resource(enum resource_id id, uint32_t subid,
 		if (rc) {
 			prerror("Failed to parse subpart info for %s\n",
 				name);
-			goto out_free_ffs;
+			goto out_unlock;
 		}
 		bufp += offset;
 		goto done_reading;
@@ -882,7 +908,7 @@ static int flash_load_resource(enum resource_id id, uint32_t subid,
 					prerror("Invalid ELF header part"
 						" %s\n", name);
 					rc = OPAL_RESOURCE;
-					goto out_free_ffs;
+					goto out_unlock;
 				}
 			} else {
 				content_size = ffs_part_size;
@@ -892,7 +918,7 @@ static int flash_load_resource(enum resource_id id, uint32_t subid,
 					" buffer size %lu\n", name,
 					content_size, bufsz);
 				rc = OPAL_PARAMETER;
-				goto out_free_ffs;
+				goto out_unlock;
 			}
 			prlog(PR_DEBUG, "computed %s size %u\n",
 			      name, content_size);
@@ -902,7 +928,7 @@ static int flash_load_resource(enum resource_id id, uint32_t subid,
 				prerror("failed to read content size %d"
 					" %s partition, rc %d\n",
 					content_size, name, rc);
-				goto out_free_ffs;
+				goto out_unlock;
 			}
 			*len = content_size;
 			goto done_reading;
@@ -914,7 +940,7 @@ static int flash_load_resource(enum resource_id id, uint32_t subid,
 		if (rc) {
 			prerror("FAILED reading subpart info. rc=%d\n",
 				rc);
-			goto out_free_ffs;
+			goto out_unlock;
 		}
 
 		*len = ffs_part_size;
@@ -949,8 +975,6 @@ done_reading:
 
 	status = true;
 
-out_free_ffs:
-	ffs_close(ffs);
 out_unlock:
 	unlock(&flash_lock);
 	return status ? OPAL_SUCCESS : rc;
@@ -18,6 +18,7 @@
 #include <timer.h>
 #include <sbe.h>
 #include <xive.h>
+#include <debug_descriptor.h>
 
 /* ICP registers */
 #define ICP_XIRR		0x4	/* 32-bit access */
@@ -28,6 +29,148 @@ static LIST_HEAD(irq_sources);
 static LIST_HEAD(irq_sources2);
 static struct lock irq_lock = LOCK_UNLOCKED;
 
+/*
+ * Sorted index of the registered sources for irq_find_source(), which
+ * sits on the interrupt hot path. Primary sources come first, then
+ * the secondary ones, each part sorted by start so a lookup is a
+ * binary search. The index is copied and updated under irq_lock when
+ * a source comes or goes and published with a single pointer store,
+ * so lookups don't need the lock.
+ */
+struct irq_index_entry {
+	uint32_t		start;
+	uint32_t		end;
+	struct irq_source	*is;
+};
+
+struct irq_index {
+	struct irq_index	*retired;
+	unsigned int		nr_primary;
+	unsigned int		nr;
+	struct irq_index_entry	ents[];
+};
+
+static struct irq_index *irq_index;
+
+/* Copies we replaced that another CPU might still be walking */
+static struct irq_index *irq_index_retired;
+
+/*
+ * Lookups only happen from within OPAL, so once every other CPU has
+ * been seen outside of it nobody can hold a copy that was replaced
+ * before we looked. The sync pairs with the one on OPAL entry, after
+ * in_opal_call is bumped.
+ */
+static bool irq_index_quiesced(void)
+{
+	struct cpu_thread *cpu;
+
+	if (opal_booting())
+		return true;
+
+	sync();
+	for_each_cpu(cpu) {
+		if (cpu != this_cpu() && cpu->in_opal_call)
+			return false;
+	}
+	return true;
+}
+
+static void irq_index_publish(struct irq_index *new)
+{
+	struct irq_index *old = irq_index;
+
+	/* Make the entries visible before the pointer */
+	lwsync();
+	irq_index = new;
+
+	if (!old)
+		return;
+
+	/*
+	 * Free what we've retired so far if we can, otherwise it waits
+	 * for the next update to find the other CPUs out of OPAL.
+	 */
+	old->retired = irq_index_retired;
+	irq_index_retired = old;
+	if (!irq_index_quiesced())
+		return;
+	while ((old = irq_index_retired)) {
+		irq_index_retired = old->retired;
+		free(old);
+	}
+}
+
+static void irq_index_add(struct irq_source *is, bool secondary)
+{
+	struct irq_index *old = irq_index, *new;
+	unsigned int nr = old ? old->nr : 0;
+	unsigned int nr_primary = old ? old->nr_primary : 0;
+	unsigned int pos, end;
+
+	new = zalloc(sizeof(*new) + (nr + 1) * sizeof(new->ents[0]));
+	assert(new);
+
+	/* Find its place in its part of the index */
+	pos = secondary ? nr_primary : 0;
+	end = secondary ? nr : nr_primary;
+	while (pos < end && old->ents[pos].start < is->start)
+		pos++;
+
+	if (pos)
+		memcpy(new->ents, old->ents, pos * sizeof(new->ents[0]));
+	new->ents[pos].start = is->start;
+	new->ents[pos].end = is->end;
+	new->ents[pos].is = is;
+	if (nr > pos)
+		memcpy(&new->ents[pos + 1], &old->ents[pos],
+		       (nr - pos) * sizeof(new->ents[0]));
+	new->nr = nr + 1;
+	new->nr_primary = nr_primary + !secondary;
+
+	irq_index_publish(new);
+}
+
+static void irq_index_del(struct irq_source *is)
+{
+	struct irq_index *old = irq_index, *new;
+	unsigned int pos;
+
+	for (pos = 0; pos < old->nr; pos++)
+		if (old->ents[pos].is == is)
+			break;
+	assert(pos < old->nr);
+
+	new = zalloc(sizeof(*new) + (old->nr - 1) * sizeof(new->ents[0]));
+	assert(new);
+	memcpy(new->ents, old->ents, pos * sizeof(new->ents[0]));
+	memcpy(&new->ents[pos], &old->ents[pos + 1],
+	       (old->nr - pos - 1) * sizeof(new->ents[0]));
+	new->nr = old->nr - 1;
+	new->nr_primary = old->nr_primary - (pos < old->nr_primary);
+
+	irq_index_publish(new);
+}
+
+static struct irq_source *irq_index_search(const struct irq_index_entry *ents,
+					   unsigned int nr, uint32_t isn)
+{
+	unsigned int lo = 0, hi = nr, mid;
+
+	/* Find the last entry starting at or below isn */
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (ents[mid].start <= isn)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo && isn < ents[lo - 1].end)
+		return ents[lo - 1].is;
+
+	return NULL;
+}
+
 void __register_irq_source(struct irq_source *is, bool secondary)
 {
 	struct irq_source *is1;
@@ -48,6 +191,7 @@ void __register_irq_source(struct irq_source *is, bool secondary)
 		}
 	}
 	list_add_tail(list, &is->link);
+	irq_index_add(is, secondary);
 	unlock(&irq_lock);
 }
 
@@ -82,6 +226,7 @@ void unregister_irq_source(uint32_t start, uint32_t count)
 				assert(0);
 			}
 			list_del(&is->link);
+			irq_index_del(is);
 			unlock(&irq_lock);
 			/* XXX Add synchronize / RCU */
 			free(is);
@@ -96,27 +241,18 @@ void unregister_irq_source(uint32_t start, uint32_t count)
 
 struct irq_source *irq_find_source(uint32_t isn)
 {
+	struct irq_index *idx = irq_index;
 	struct irq_source *is;
 
-	lock(&irq_lock);
-	/*
-	 * XXX This really needs some kind of caching !
-	 */
-	list_for_each(&irq_sources, is, link) {
-		if (isn >= is->start && isn < is->end) {
-			unlock(&irq_lock);
-			return is;
-		}
-	}
-	list_for_each(&irq_sources2, is, link) {
-		if (isn >= is->start && isn < is->end) {
-			unlock(&irq_lock);
-			return is;
-		}
-	}
-	unlock(&irq_lock);
+	if (!idx)
+		return NULL;
 
-	return NULL;
+	is = irq_index_search(idx->ents, idx->nr_primary, isn);
+	if (!is)
+		is = irq_index_search(&idx->ents[idx->nr_primary],
+				      idx->nr - idx->nr_primary, isn);
+
+	return is;
 }
 
 void irq_for_each_source(void (*cb)(struct irq_source *, void *), void *data)
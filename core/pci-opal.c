@@ -94,6 +94,83 @@ opal_call(OPAL_PCI_CONFIG_WRITE_BYTE, opal_pci_config_write_byte, 4);
 opal_call(OPAL_PCI_CONFIG_WRITE_HALF_WORD, opal_pci_config_write_half_word, 4);
 opal_call(OPAL_PCI_CONFIG_WRITE_WORD, opal_pci_config_write_word, 4);
 
+static int64_t pci_config_batch_one(struct phb *phb, struct opal_pci_cfg_op *op)
+{
+	uint32_t bdfn = be16_to_cpu(op->bdfn);
+	uint32_t offset = be32_to_cpu(op->offset);
+	uint32_t val = be32_to_cpu(op->value);
+	uint8_t v8;
+	uint16_t v16;
+	int64_t rc;
+
+	switch (op->op) {
+	case OPAL_PCI_CFG_BATCH_READ:
+		switch (op->size) {
+		case 1:
+			rc = phb->ops->cfg_read8(phb, bdfn, offset, &v8);
+			val = v8;
+			break;
+		case 2:
+			rc = phb->ops->cfg_read16(phb, bdfn, offset, &v16);
+			val = v16;
+			break;
+		case 4:
+			rc = phb->ops->cfg_read32(phb, bdfn, offset, &val);
+			break;
+		default:
+			return OPAL_PARAMETER;
+		}
+		op->value = cpu_to_be32(val);
+		break;
+	case OPAL_PCI_CFG_BATCH_WRITE:
+		switch (op->size) {
+		case 1:
+			rc = phb->ops->cfg_write8(phb, bdfn, offset, val);
+			break;
+		case 2:
+			rc = phb->ops->cfg_write16(phb, bdfn, offset, val);
+			break;
+		case 4:
+			rc = phb->ops->cfg_write32(phb, bdfn, offset, val);
+			break;
+		default:
+			return OPAL_PARAMETER;
+		}
+		break;
+	default:
+		return OPAL_PARAMETER;
+	}
+
+	return rc;
+}
+
+/*
+ * Config space accesses in bulk, for driver probe and config space
+ * emulation which otherwise pay an OPAL entry and a PHB lock round
+ * trip per access. The length is bounded so that we don't hold the
+ * PHB lock for too long.
+ */
+static int64_t opal_pci_config_batch(uint64_t phb_id,
+				     struct opal_pci_cfg_op *ops,
+				     uint64_t count)
+{
+	struct phb *phb = pci_get_phb(phb_id);
+	uint64_t i;
+
+	if (!phb)
+		return OPAL_PARAMETER;
+	if (!count || count > OPAL_PCI_CONFIG_BATCH_MAX || !opal_addr_valid(ops))
+		return OPAL_PARAMETER;
+
+	phb_lock(phb);
+	for (i = 0; i < count; i++)
+		ops[i].status = cpu_to_be64(pci_config_batch_one(phb, &ops[i]));
+	phb_unlock(phb);
+
+	return OPAL_SUCCESS;
+}
+opal_call(OPAL_PCI_CONFIG_BATCH, opal_pci_config_batch, 3);
+
 static struct lock opal_eeh_evt_lock = LOCK_UNLOCKED;
 static uint64_t opal_eeh_evt = 0;
 
@@ -364,6 +441,77 @@ static int64_t opal_pci_set_xive_pe(uint64_t phb_id, uint64_t pe_number,
 }
 opal_call(OPAL_PCI_SET_XIVE_PE, opal_pci_set_xive_pe, 3);
 
+static int64_t pci_set_pes_one(struct phb *phb, struct opal_pci_pe_op *op)
+{
+	const struct phb_ops *ops = phb->ops;
+	uint64_t pe_number = be32_to_cpu(op->pe_number);
+	uint64_t a[ARRAY_SIZE(op->args)];
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(a); i++)
+		a[i] = be64_to_cpu(op->args[i]);
+
+	switch (be32_to_cpu(op->op)) {
+	case OPAL_PCI_PE_OP_SET_PE:
+		if (!ops->set_pe)
+			return OPAL_UNSUPPORTED;
+		return ops->set_pe(phb, pe_number, a[0], a[1], a[2], a[3], a[4]);
+	case OPAL_PCI_PE_OP_SET_PELTV:
+		if (!ops->set_peltv)
+			return OPAL_UNSUPPORTED;
+		return ops->set_peltv(phb, a[0], pe_number, a[1]);
+	case OPAL_PCI_PE_OP_MAP_MMIO:
+		if (!ops->map_pe_mmio_window)
+			return OPAL_UNSUPPORTED;
+		return ops->map_pe_mmio_window(phb, pe_number, a[0], a[1], a[2]);
+	case OPAL_PCI_PE_OP_MAP_DMA:
+		if (!ops->map_pe_dma_window)
+			return OPAL_UNSUPPORTED;
+		return ops->map_pe_dma_window(phb, pe_number, a[0], a[1], a[2],
+					      a[3], a[4]);
+	case OPAL_PCI_PE_OP_MAP_DMA_REAL:
+		if (!ops->map_pe_dma_window_real)
+			return OPAL_UNSUPPORTED;
+		return ops->map_pe_dma_window_real(phb, pe_number, a[0], a[1],
+						   a[2]);
+	case OPAL_PCI_PE_OP_SET_XIVE:
+		if (!ops->set_xive_pe)
+			return OPAL_UNSUPPORTED;
+		return ops->set_xive_pe(phb, pe_number, a[0]);
+	}
+
+	return OPAL_PARAMETER;
+}
+
+/*
+ * PE setup in bulk, for bringing up lots of SR-IOV VFs at once. The
+ * PHB lock is taken once and the backend gets to flush its tables
+ * once at the end rather than after every call.
+ */
+static int64_t opal_pci_set_pes(uint64_t phb_id, struct opal_pci_pe_op *ops,
+				uint64_t count)
+{
+	struct phb *phb = pci_get_phb(phb_id);
+	uint64_t i;
+
+	if (!phb)
+		return OPAL_PARAMETER;
+	if (!count || count > OPAL_PCI_SET_PES_MAX || !opal_addr_valid(ops))
+		return OPAL_PARAMETER;
+
+	phb_lock(phb);
+	if (phb->ops->pe_batch_start)
+		phb->ops->pe_batch_start(phb);
+	for (i = 0; i < count; i++)
+		ops[i].status = cpu_to_be64(pci_set_pes_one(phb, &ops[i]));
+	if (phb->ops->pe_batch_end)
+		phb->ops->pe_batch_end(phb);
+	phb_unlock(phb);
+
+	return OPAL_SUCCESS;
+}
+opal_call(OPAL_PCI_SET_PES, opal_pci_set_pes, 3);
+
 static int64_t opal_get_msi_32(uint64_t phb_id, uint32_t mve_number,
 			       uint32_t xive_num, uint8_t msi_range,
 			       __be32 *__msi_address, __be32 *__message_data)
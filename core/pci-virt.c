@@ -42,6 +42,7 @@ static struct pci_cfg_reg_filter *pci_virt_find_filter(
 					uint32_t start, uint32_t len)
 {
 	struct pci_cfg_reg_filter *pcrf;
+	int i;
 
 	if (!pvd || !len || start >= pvd->cfg_size)
 		return NULL;
@@ -50,12 +51,17 @@ static struct pci_cfg_reg_filter *pci_virt_find_filter(
 	 * require strict matching for more flexibility. It also
 	 * means the associated handler should validate the register
 	 * offset and length.
+	 *
+	 * Filters don't overlap each other, so only the last one
+	 * starting before the end of the access can overlap it.
 	 */
-	list_for_each(&pvd->pcrf, pcrf, link) {
-		if (start < (pcrf->start + pcrf->len) &&
-		    (start + len) > pcrf->start)
-			return pcrf;
-	}
+	i = pci_cfg_filter_table_search(pvd->pcrf_table, start + len - 1);
+	if (i < 0)
+		return NULL;
+
+	pcrf = pvd->pcrf_table->ents[i].pcrf;
+	if (start < (pcrf->start + pcrf->len))
+		return pcrf;
 
 	return NULL;
 }
@@ -92,6 +98,11 @@ struct pci_cfg_reg_filter *pci_virt_add_filter(struct pci_virt_device *pvd,
 	pcrf->flags = flags;
 	pcrf->func  = func;
 	pcrf->data  = data;
+	if (!pci_cfg_filter_table_add(&pvd->pcrf_table, pcrf)) {
+		prlog(PR_ERR, "%s: Out of memory!\n", __func__);
+		free(pcrf);
+		return NULL;
+	}
 	list_add_tail(&pvd->pcrf, &pcrf->link);
 
 	return pcrf;
@@ -54,29 +54,8 @@ static int64_t __pci_find_cap(struct phb *phb, uint16_t bdfn,
 	return OPAL_UNSUPPORTED;
 }
 
-/* pci_find_cap - Find a PCI capability in a device config space
- *
- * This will return a config space offset (positive) or a negative
- * error (OPAL error codes).
- *
- * OPAL_UNSUPPORTED is returned if the capability doesn't exist
- */
-int64_t pci_find_cap(struct phb *phb, uint16_t bdfn, uint8_t want)
-{
-	return __pci_find_cap(phb, bdfn, want, true);
-}
-
-/* pci_find_ecap - Find a PCIe extended capability in a device
- *                 config space
- *
- * This will return a config space offset (positive) or a negative
- * error (OPAL error code). Additionally, if the "version" argument
- * is non-NULL, the capability version will be returned there.
- *
- * OPAL_UNSUPPORTED is returned if the capability doesn't exist
- */
-int64_t pci_find_ecap(struct phb *phb, uint16_t bdfn, uint16_t want,
-		      uint8_t *version)
+static int64_t __pci_find_ecap(struct phb *phb, uint16_t bdfn, uint16_t want,
+			       uint8_t *version)
 {
 	int64_t rc;
 	uint32_t cap;
@@ -105,6 +84,177 @@ int64_t pci_find_ecap(struct phb *phb, uint16_t bdfn, uint16_t want,
 	return OPAL_UNSUPPORTED;
 }
 
+/*
+ * Config cache
+ *
+ * The capability lists of a device are walked at most once while it's
+ * enumerated, the first lookup records the offset of everything that
+ * is found. Lookups of IDs we don't keep, or walks that failed, go to
+ * the hardware as before.
+ */
+static void pci_cfg_cache_walk_caps(struct phb *phb, struct pci_device *pd)
+{
+	struct pci_cfg_cache *cc = pd->cfg_cache;
+	uint16_t stat, cap;
+	uint8_t pos, id;
+	int i;
+
+	if (pci_cfg_read16(phb, pd->bdfn, PCI_CFG_STAT, &stat))
+		return;
+	if (!(stat & PCI_CFG_STAT_CAP)) {
+		cc->caps_walked = true;
+		return;
+	}
+	if (pci_cfg_read8(phb, pd->bdfn, PCI_CFG_CAP, &pos))
+		return;
+
+	/* There's room for 48 capabilities in the header */
+	for (i = 0, pos &= 0xfc; pos && i < 48; i++) {
+		if (pci_cfg_read16(phb, pd->bdfn, pos, &cap))
+			return;
+		id = cap & 0xff;
+		if (id < PCI_CFG_CACHE_CAPS && !cc->cap_pos[id])
+			cc->cap_pos[id] = pos;
+		if (((cap >> 8) & 0xfc) == pos) {
+			PCIERR(phb, pd->bdfn, "pci_find_cap hit a loop !\n");
+			break;
+		}
+		pos = (cap >> 8) & 0xfc;
+	}
+	cc->caps_walked = true;
+}
+
+static int64_t pci_dev_find_cap(struct phb *phb, struct pci_device *pd,
+				uint8_t want)
+{
+	struct pci_cfg_cache *cc = pd->cfg_cache;
+
+	if (cc && !cc->caps_walked)
+		pci_cfg_cache_walk_caps(phb, pd);
+	if (!cc || !cc->caps_walked || want >= PCI_CFG_CACHE_CAPS)
+		return __pci_find_cap(phb, pd->bdfn, want, true);
+
+	return cc->cap_pos[want] ? cc->cap_pos[want] : OPAL_UNSUPPORTED;
+}
+
+static void pci_cfg_cache_walk_ecaps(struct phb *phb, struct pci_device *pd)
+{
+	struct pci_cfg_cache *cc = pd->cfg_cache;
+	uint16_t off, prev = 0, id;
+	uint32_t cap;
+
+	for (off = 0x100; off && off < 0x1000; off = (cap >> 20) & 0xffc) {
+		if (off == prev) {
+			PCIERR(phb, pd->bdfn, "pci_find_ecap hit a loop !\n");
+			break;
+		}
+		prev = off;
+		if (pci_cfg_read32(phb, pd->bdfn, off, &cap))
+			return;
+		if (cap == 0 || (cap & 0xffff) == 0xffff)
+			break;
+
+		id = cap & 0xffff;
+		if (id < PCI_CFG_CACHE_ECAPS && !cc->ecap_pos[id]) {
+			cc->ecap_pos[id] = off;
+			cc->ecap_ver[id] = (cap >> 16) & 0xf;
+		}
+	}
+	cc->ecaps_walked = true;
+}
+
+static int64_t pci_dev_find_ecap(struct phb *phb, struct pci_device *pd,
+				 uint16_t want, uint8_t *version)
+{
+	struct pci_cfg_cache *cc = pd->cfg_cache;
+
+	if (cc && !cc->ecaps_walked)
+		pci_cfg_cache_walk_ecaps(phb, pd);
+	if (!cc || !cc->ecaps_walked || want >= PCI_CFG_CACHE_ECAPS)
+		return __pci_find_ecap(phb, pd->bdfn, want, version);
+	if (!cc->ecap_pos[want])
+		return OPAL_UNSUPPORTED;
+
+	if (version)
+		*version = cc->ecap_ver[want];
+	return cc->ecap_pos[want];
+}
+
+static void pci_cfg_cache_free(struct pci_device *pd)
+{
+	if (!pd->cfg_cache)
+		return;
+
+	free(pd->cfg_cache);
+	pd->cfg_cache = NULL;
+	pd->phb->cfg_caches--;
+}
+
+/* Drop the cache of a device when a register it holds is written */
+void pci_cfg_cache_write(struct phb *phb, uint16_t bdfn, uint32_t offset)
+{
+	struct pci_device *pd = pci_find_dev(phb, bdfn);
+	struct pci_cfg_cache *cc;
+	int i;
+
+	if (!pd || !pd->cfg_cache)
+		return;
+
+	cc = pd->cfg_cache;
+	offset &= ~3;
+	if (offset == PCI_CFG_REV_ID || offset == (PCI_CFG_CAP & ~3))
+		goto drop;
+	for (i = 0; i < PCI_CFG_CACHE_CAPS; i++)
+		if (cc->cap_pos[i] && (cc->cap_pos[i] & ~3) == offset)
+			goto drop;
+	for (i = 0; i < PCI_CFG_CACHE_ECAPS; i++)
+		if (cc->ecap_pos[i] == offset)
+			goto drop;
+	return;
+ drop:
+	PCIDBG(phb, bdfn, "Config cache dropped, write at 0x%x\n", offset);
+	pci_cfg_cache_free(pd);
+}
+
+/* pci_find_cap - Find a PCI capability in a device config space
+ *
+ * This will return a config space offset (positive) or a negative
+ * error (OPAL error codes).
+ *
+ * OPAL_UNSUPPORTED is returned if the capability doesn't exist
+ */
+int64_t pci_find_cap(struct phb *phb, uint16_t bdfn, uint8_t want)
+{
+	struct pci_device *pd;
+
+	pd = phb->cfg_caches ? pci_find_dev(phb, bdfn) : NULL;
+	if (pd)
+		return pci_dev_find_cap(phb, pd, want);
+
+	return __pci_find_cap(phb, bdfn, want, true);
+}
+
+/* pci_find_ecap - Find a PCIe extended capability in a device
+ *                 config space
+ *
+ * This will return a config space offset (positive) or a negative
+ * error (OPAL error code). Additionally, if the "version" argument
+ * is non-NULL, the capability version will be returned there.
+ *
+ * OPAL_UNSUPPORTED is returned if the capability doesn't exist
+ */
+int64_t pci_find_ecap(struct phb *phb, uint16_t bdfn, uint16_t want,
+		      uint8_t *version)
+{
+	struct pci_device *pd;
+
+	pd = phb->cfg_caches ? pci_find_dev(phb, bdfn) : NULL;
+	if (pd)
+		return pci_dev_find_ecap(phb, pd, want, version);
+
+	return __pci_find_ecap(phb, bdfn, want, version);
+}
+
 static void pci_init_pcie_cap(struct phb *phb, struct pci_device *pd)
 {
 	int64_t ecap = 0;
@@ -120,14 +270,17 @@ static void pci_init_pcie_cap(struct phb *phb, struct pci_device *pd)
 	if (pd->vdid == 0x872410b5 && pd->parent && !pd->parent->parent) {
 		uint8_t rev;
 
-		pci_cfg_read8(phb, pd->bdfn, PCI_CFG_REV_ID, &rev);
+		if (pd->cfg_cache)
+			rev = pd->cfg_cache->rev_class & 0xff;
+		else
+			pci_cfg_read8(phb, pd->bdfn, PCI_CFG_REV_ID, &rev);
 		if (rev == 0xba)
 			ecap = __pci_find_cap(phb, pd->bdfn,
 					      PCI_CFG_CAP_ID_EXP, false);
 		else
-			ecap = pci_find_cap(phb, pd->bdfn, PCI_CFG_CAP_ID_EXP);
+			ecap = pci_dev_find_cap(phb, pd, PCI_CFG_CAP_ID_EXP);
 	} else {
-		ecap = pci_find_cap(phb, pd->bdfn, PCI_CFG_CAP_ID_EXP);
+		ecap = pci_dev_find_cap(phb, pd, PCI_CFG_CAP_ID_EXP);
 	}
 
 	if (ecap <= 0) {
@@ -169,7 +322,7 @@ static void pci_init_aer_cap(struct phb *phb, struct pci_device *pd)
 	if (!pci_has_cap(pd, PCI_CFG_CAP_ID_EXP, false))
 		return;
 
-	pos = pci_find_ecap(phb, pd->bdfn, PCIECAP_ID_AER, NULL);
+	pos = pci_dev_find_ecap(phb, pd, PCIECAP_ID_AER, NULL);
 	if (pos > 0)
 		pci_set_cap(pd, PCIECAP_ID_AER, pos, NULL, NULL, true);
 }
@@ -178,7 +331,7 @@ static void pci_init_pm_cap(struct phb *phb, struct pci_device *pd)
 {
 	int64_t pos;
 
-	pos = pci_find_cap(phb, pd->bdfn, PCI_CFG_CAP_ID_PM);
+	pos = pci_dev_find_cap(phb, pd, PCI_CFG_CAP_ID_PM);
 	if (pos > 0)
 		pci_set_cap(pd, PCI_CFG_CAP_ID_PM, pos, NULL, NULL, false);
 }
@@ -219,17 +372,82 @@ bool pci_wait_crs(struct phb *phb, uint16_t bdfn, uint32_t *out_vdid)
 	return true;
 }
 
-static struct pci_device *pci_scan_one(struct phb *phb, struct pci_device *parent,
-				       uint16_t bdfn)
+static void pci_index_add(struct phb *phb, struct pci_device *pd)
+{
+	struct pci_device ***bus = &phb->dev_index[PCI_BUS_NUM(pd->bdfn)];
+
+	if (!*bus) {
+		*bus = zalloc(256 * sizeof(struct pci_device *));
+		assert(*bus);
+	}
+	(*bus)[pd->bdfn & 0xff] = pd;
+}
+
+static void pci_index_del(struct phb *phb, struct pci_device *pd)
+{
+	struct pci_device **bus = phb->dev_index[PCI_BUS_NUM(pd->bdfn)];
+
+	/* The bus table is kept, it will likely be repopulated */
+	if (bus && bus[pd->bdfn & 0xff] == pd)
+		bus[pd->bdfn & 0xff] = NULL;
+}
+
+/* Read the vendor/device ID, false if there's nothing there */
+static bool pci_probe(struct phb *phb, uint16_t bdfn, uint32_t *vdid)
+{
+	if (pci_cfg_read32(phb, bdfn, PCI_CFG_VENDOR_ID, vdid))
+		return false;
+
+	return *vdid != 0xffffffff && *vdid != 0x00000000;
+}
+
+/*
+ * Wait for all the devices of a bus that returned CRS in the first
+ * probe together rather than one after the other. Same budget as
+ * pci_wait_crs(), the ones that are still not ready are dropped.
+ */
+static uint32_t pci_wait_crs_map(struct phb *phb, uint8_t bus,
+				 uint32_t crs_map, uint32_t *vdids)
+{
+	uint32_t present = 0, retries, dev;
+	uint16_t bdfn;
+
+	for (retries = 1; crs_map && retries < 40; retries++) {
+		time_wait_ms(100);
+		for (dev = 0; dev < 32; dev++) {
+			if (!(crs_map & (1u << dev)))
+				continue;
+
+			bdfn = ((uint16_t)bus << 8) | (dev << 3);
+			if (!pci_probe(phb, bdfn, &vdids[dev])) {
+				crs_map &= ~(1u << dev);
+			} else if (vdids[dev] != 0xffff0001) {
+				PCIDBG(phb, bdfn, "Probe success after %d CRS\n",
+				       retries);
+				crs_map &= ~(1u << dev);
+				present |= 1u << dev;
+			}
+			pci_check_clear_freeze(phb);
+		}
+	}
+
+	for (dev = 0; dev < 32; dev++)
+		if (crs_map & (1u << dev))
+			PCIERR(phb, ((uint16_t)bus << 8) | (dev << 3),
+			       "CRS timeout !\n");
+
+	return present;
+}
+
+static struct pci_device *__pci_scan_one(struct phb *phb,
+					 struct pci_device *parent,
+					 uint16_t bdfn, uint32_t vdid)
 {
 	struct pci_device *pd = NULL;
-	uint32_t vdid;
+	uint32_t reads = phb->cfg_reads;
 	int64_t rc;
 	uint8_t htype;
 
-	if (!pci_wait_crs(phb, bdfn, &vdid))
-		return NULL;
-
 	/* Perform a dummy write to the device in order for it to
 	 * capture it's own bus number, so any subsequent error
 	 * messages will be properly tagged
@@ -246,7 +464,6 @@ static struct pci_device *pci_scan_one(struct phb *phb, struct pci_device *paren
 	pd->vdid = vdid;
 	pci_cfg_read32(phb, bdfn, PCI_CFG_SUBSYS_VENDOR_ID, &pd->sub_vdid);
 	pci_cfg_read32(phb, bdfn, PCI_CFG_REV_ID, &pd->class);
-	pd->class >>= 8;
 
 	pd->parent = parent;
 	list_head_init(&pd->pcrf);
@@ -256,6 +473,12 @@ static struct pci_device *pci_scan_one(struct phb *phb, struct pci_device *paren
 		PCIERR(phb, bdfn, "Failed to read header type !\n");
 		goto fail;
 	}
+	pd->cfg_cache = zalloc(sizeof(struct pci_cfg_cache));
+	if (pd->cfg_cache) {
+		pd->cfg_cache->rev_class = pd->class;
+		phb->cfg_caches++;
+	}
+	pd->class >>= 8;
 	pd->is_multifunction = !!(htype & 0x80);
 	pd->is_bridge = (htype & 0x7f) != 0;
 	pd->is_vf = false;
@@ -293,6 +516,7 @@ static struct pci_device *pci_scan_one(struct phb *phb, struct pci_device *paren
 		list_add_tail(&phb->devices, &pd->link);
 	else
 		list_add_tail(&parent->children, &pd->link);
+	pci_index_add(phb, pd);
 
 	/*
 	 * Call PHB hook
@@ -300,6 +524,7 @@ static struct pci_device *pci_scan_one(struct phb *phb, struct pci_device *paren
 	if (phb->ops->device_init)
 		phb->ops->device_init(phb, pd, NULL);
 
+	pd->cfg_reads = phb->cfg_reads - reads;
 	return pd;
  fail:
 	if (pd)
@@ -307,6 +532,17 @@ static struct pci_device *pci_scan_one(struct phb *phb, struct pci_device *paren
 	return NULL;
 }
 
+static struct pci_device *pci_scan_one(struct phb *phb, struct pci_device *parent,
+				       uint16_t bdfn)
+{
+	uint32_t vdid;
+
+	if (!pci_wait_crs(phb, bdfn, &vdid))
+		return NULL;
+
+	return __pci_scan_one(phb, parent, bdfn, vdid);
+}
+
 /* pci_check_clear_freeze - Probing empty slot will result in an EEH
  *                          freeze. Currently we have a single PE mapping
  *                          everything (default state of our backend) so
@@ -559,16 +795,31 @@ static bool pci_bridge_wait_link(struct phb *phb,
 	return true;
 }
 
-/* pci_enable_bridge - Called before scanning a bridge
+/*
+ * Bridges are brought up in two steps so that all the bridges on a
+ * bus train their links at the same time: pci_enable_bridge_start()
+ * kicks them all, then pci_enable_bridge_finish() waits for each of
+ * them in turn just before scanning behind it.
+ */
+enum pci_link_state {
+	PCI_LINK_EMPTY,		/* Nothing behind the bridge */
+	PCI_LINK_UP,		/* Link already up, scan right away */
+	PCI_LINK_WAIT,		/* Wait for link_ready_tb then the link */
+};
+
+/* pci_enable_bridge_start - Called before scanning a bridge
  *
  * Ensures error flags are clean, disable master abort, and
  * check if the subordinate bus isn't reset, the slot is enabled
  * on PCIe, etc...
  */
-static bool pci_enable_bridge(struct phb *phb, struct pci_device *pd)
+static void pci_enable_bridge_start(struct phb *phb, struct pci_device *pd)
 {
 	uint16_t bctl;
-	bool was_reset = false;
+
+	pd->link_state = PCI_LINK_WAIT;
+	pd->link_was_reset = false;
+	pd->link_ready_tb = mftb();
 
 	/* Disable master aborts, clear errors */
 	pci_cfg_read16(phb, pd->bdfn, PCI_CFG_BRCTL, &bctl);
@@ -608,29 +859,46 @@ static bool pci_enable_bridge(struct phb *phb, struct pci_device *pd)
 			pci_cfg_read16(phb, pd->bdfn,
 				       ecap + PCICAP_EXP_LSTAT, &link_sts);
 			if ((link_cap & PCICAP_EXP_LCAP_DL_ACT_REP) &&
-			    (link_sts & PCICAP_EXP_LSTAT_DLLL_ACT))
-				return true;
+			    (link_sts & PCICAP_EXP_LSTAT_DLLL_ACT)) {
+				pd->link_state = PCI_LINK_UP;
+				return;
+			}
 		}
 
 		/* Power on the downstream slot or link */
-		if (!pci_bridge_power_on(phb, pd))
-			return false;
+		if (!pci_bridge_power_on(phb, pd)) {
+			pd->link_state = PCI_LINK_EMPTY;
+			return;
+		}
 	}
 
-	/* Clear secondary reset */
+	/* Clear secondary reset, the 1s wait is done in _finish() */
 	if (bctl & PCI_CFG_BRCTL_SECONDARY_RESET) {
 		PCIDBG(phb, pd->bdfn,
 		       "Bridge secondary reset is on, clearing it ...\n");
 		bctl &= ~PCI_CFG_BRCTL_SECONDARY_RESET;
 		pci_cfg_write16(phb, pd->bdfn, PCI_CFG_BRCTL, bctl);
-		time_wait_ms(1000);
-		was_reset = true;
+		pd->link_ready_tb = mftb() + msecs_to_tb(1000);
+		pd->link_was_reset = true;
 	}
+}
+
+/* Returns false if we know there's nothing behind the bridge */
+static bool pci_enable_bridge_finish(struct phb *phb, struct pci_device *pd)
+{
+	uint64_t now = mftb();
+
+	if (pd->link_state != PCI_LINK_WAIT)
+		return pd->link_state == PCI_LINK_UP;
+
+	/* Whatever is left of the wait after a secondary reset */
+	if (tb_compare(now, pd->link_ready_tb) == TB_ABEFOREB)
+		time_wait(pd->link_ready_tb - now);
 
 	/* PCI-E bridge, wait for link */
 	if (pd->dev_type == PCIE_TYPE_ROOT_PORT ||
 	    pd->dev_type == PCIE_TYPE_SWITCH_DNPORT) {
-		if (!pci_bridge_wait_link(phb, pd, was_reset))
+		if (!pci_bridge_wait_link(phb, pd, pd->link_was_reset))
 			return false;
 	}
 
@@ -688,6 +956,9 @@ void pci_remove_bus(struct phb *phb, struct list_head *list)
 
 		/* Remove from parent list and release itself */
 		list_del(&pd->link);
+		pci_index_del(phb, pd);
+		pci_cfg_cache_free(pd);
+		free(pd->pcrf_table);
 		free(pd);
 	}
 }
@@ -742,18 +1013,38 @@ uint8_t pci_scan_bus(struct phb *phb, uint8_t bus, uint8_t max_bus,
 {
 	struct pci_device *pd = NULL, *rc = NULL;
 	uint8_t dev, fn, next_bus, max_sub;
-	uint32_t scan_map;
+	uint32_t scan_map, present = 0, crs_map = 0;
+	uint32_t vdids[32];
 
 	/* Decide what to scan  */
 	scan_map = parent ? parent->scan_map : phb->scan_map;
 
-	/* Do scan */
+	/* Probe all the slots first, so that the devices still
+	 * returning CRS are then waited for all at once.
+	 */
 	for (dev = 0; dev < 32; dev++) {
 		if (!(scan_map & (1ul << dev)))
 			continue;
 
+		if (pci_probe(phb, (bus << 8) | (dev << 3), &vdids[dev])) {
+			if (vdids[dev] == 0xffff0001)
+				crs_map |= 1u << dev;
+			else
+				present |= 1u << dev;
+		}
+		pci_check_clear_freeze(phb);
+	}
+	if (crs_map)
+		present |= pci_wait_crs_map(phb, bus, crs_map, vdids);
+
+	/* Do scan */
+	for (dev = 0; dev < 32; dev++) {
+		if (!(present & (1ul << dev)))
+			continue;
+
 		/* Scan the device */
-		pd = pci_scan_one(phb, parent, (bus << 8) | (dev << 3));
+		pd = __pci_scan_one(phb, parent, (bus << 8) | (dev << 3),
+				    vdids[dev]);
 		pci_check_clear_freeze(phb);
 		if (!pd)
 			continue;
@@ -807,6 +1098,15 @@ uint8_t pci_scan_bus(struct phb *phb, uint8_t bus, uint8_t max_bus,
 	next_bus = bus + 1;
 	max_sub = bus;
 
+	/* Clear up bridge resources and get all the links going */
+	list_for_each(list, pd, link) {
+		if (!pd->is_bridge)
+			continue;
+
+		pci_cleanup_bridge(phb, pd);
+		pci_enable_bridge_start(phb, pd);
+	}
+
 	/* Scan down bridges */
 	list_for_each(list, pd, link) {
 		bool do_scan;
@@ -830,15 +1130,11 @@ uint8_t pci_scan_bus(struct phb *phb, uint8_t bus, uint8_t max_bus,
 		PCIDBG(phb, pd->bdfn, "Bus %02x..%02x scanning...\n",
 		       next_bus, max_bus);
 
-		/* Clear up bridge resources */
-		pci_cleanup_bridge(phb, pd);
-
-		/* Configure the bridge. This will enable power to the slot
-		 * if it's currently disabled, lift reset, etc...
+		/* Wait for the bridge we started above to be ready.
 		 *
 		 * Return false if we know there's nothing behind the bridge
 		 */
-		do_scan = pci_enable_bridge(phb, pd);
+		do_scan = pci_enable_bridge_finish(phb, pd);
 
 		/* Perform recursive scan */
 		if (do_scan) {
@@ -958,33 +1254,99 @@ void pci_device_init(struct phb *phb, struct pci_device *pd)
 	pci_disable_completion_timeout(phb, pd);
 }
 
-static void pci_reset_phb(void *data)
+/* Progress of the reset state machine of one PHB slot */
+struct pci_reset_sm {
+	struct phb	*phb;
+	uint64_t	start;		/* When we started */
+	uint64_t	next;		/* When to run the state machine again */
+	int64_t		rc;		/* Last run_sm() result */
+};
+
+static void pci_reset_sm_step(struct pci_reset_sm *sm, uint64_t now)
 {
-	struct phb *phb = data;
+	struct phb *phb = sm->phb;
 	struct pci_slot *slot = phb->slot;
-	int64_t rc;
 
-	if (!slot || !slot->ops.run_sm) {
-		PCINOTICE(phb, 0, "Cannot issue reset\n");
+	sm->rc = slot->ops.run_sm(slot);
+	if (sm->rc > 0) {
+		PCITRACE(phb, 0, "Waiting %ld ms\n", tb_to_msecs(sm->rc));
+		sm->next = now + sm->rc;
 		return;
 	}
 
-	pci_slot_add_flags(slot, PCI_SLOT_FLAG_BOOTUP);
-	rc = slot->ops.run_sm(slot);
-	while (rc > 0) {
-		PCITRACE(phb, 0, "Waiting %ld ms\n", tb_to_msecs(rc));
-		time_wait(rc);
-		rc = slot->ops.run_sm(slot);
-	}
 	pci_slot_remove_flags(slot, PCI_SLOT_FLAG_BOOTUP);
-	if (rc < 0)
-		PCIDBG(phb, 0, "Error %lld resetting\n", rc);
+	if (sm->rc < 0)
+		PCIDBG(phb, 0, "Error %lld resetting\n", sm->rc);
+	PCINOTICE(phb, 0, "Reset and link training took %lu ms\n",
+		  tb_to_msecs(mftb() - sm->start));
+}
+
+/*
+ * Reset all the PHBs and train their links. Rather than having a CPU
+ * per PHB spinning in time_wait() between state machine steps, all
+ * the slots are stepped from this one loop as their delay expires,
+ * so the link training waits of all the PHBs overlap.
+ */
+static void pci_reset_phbs(void)
+{
+	struct pci_reset_sm *sms, *sm;
+	unsigned int i, nr = 0, busy;
+	uint64_t now, next;
+
+	sms = zalloc(sizeof(struct pci_reset_sm) * ARRAY_SIZE(phbs));
+	assert(sms);
+
+	for (i = 0; i < ARRAY_SIZE(phbs); i++) {
+		struct phb *phb = phbs[i];
+
+		if (!phb)
+			continue;
+		if (!phb->slot || !phb->slot->ops.run_sm) {
+			PCINOTICE(phb, 0, "Cannot issue reset\n");
+			continue;
+		}
+
+		sm = &sms[nr++];
+		sm->phb = phb;
+		sm->start = mftb();
+		pci_slot_add_flags(phb->slot, PCI_SLOT_FLAG_BOOTUP);
+		pci_reset_sm_step(sm, sm->start);
+	}
+
+	for (;;) {
+		busy = 0;
+		next = 0;
+		now = mftb();
+		for (i = 0; i < nr; i++) {
+			sm = &sms[i];
+			if (sm->rc <= 0)
+				continue;
+			if (tb_compare(now, sm->next) != TB_ABEFOREB) {
+				pci_reset_sm_step(sm, now);
+				if (sm->rc <= 0)
+					continue;
+			}
+			if (!busy++ || tb_compare(sm->next, next) == TB_ABEFOREB)
+				next = sm->next;
+		}
+		if (!busy)
+			break;
+
+		/* Sleep until the earliest slot wants attention */
+		now = mftb();
+		if (tb_compare(now, next) == TB_ABEFOREB)
+			time_wait(next - now);
+	}
+
+	free(sms);
 }
 
 static void pci_scan_phb(void *data)
 {
 	struct phb *phb = data;
 	struct pci_slot *slot = phb->slot;
+	uint64_t start = mftb();
+	uint32_t reads = phb->cfg_reads;
 	uint8_t link;
 	uint32_t mps = 0xffffffff;
 	int64_t rc;
@@ -1015,6 +1377,9 @@ static void pci_scan_phb(void *data)
 	pci_walk_dev(phb, NULL, pci_get_mps, &mps);
 	phb->mps = mps;
 	pci_walk_dev(phb, NULL, pci_configure_mps, NULL);
+
+	PCINOTICE(phb, 0, "Enumeration took %lu ms, %u config reads\n",
+		  tb_to_msecs(mftb() - start), phb->cfg_reads - reads);
 }
 
 int64_t pci_register_phb(struct phb *phb, int opal_id)
@@ -1418,13 +1783,18 @@ static void pci_add_loc_code(struct dt_node *np)
 	dt_add_property_string(np, "ibm,loc-code", lcode);
 }
 
-static void pci_print_summary_line(struct phb *phb, struct pci_device *pd,
-				   struct dt_node *np, u32 rev_class,
-				   const char *cname)
+static void pci_print_summary_line(struct phb *phb, struct pci_device *pd)
 {
-	const char *label, *dtype, *s;
+	struct dt_node *np = pd->dn;
+	const char *label, *dtype, *s, *cname;
 #define MAX_SLOTSTR 80
 	char slotstr[MAX_SLOTSTR  + 1] = { 0, };
+	u32 rev_class;
+
+	/* What the node was created with, root port class fixup included */
+	rev_class = dt_prop_get_u32(np, "class-code") << 8 |
+		dt_prop_get_u32(np, "revision-id");
+	cname = pci_class_name(rev_class >> 8);
 
 	/* If it's a slot, it has a slot-label */
 	label = dt_prop_get_def(np, "ibm,slot-label", NULL);
@@ -1491,7 +1861,10 @@ static void __noinline pci_add_one_device_node(struct phb *phb,
 	uint8_t intpin;
 	bool is_pcie;
 
-	pci_cfg_read32(phb, pd->bdfn, PCI_CFG_REV_ID, &rev_class);
+	if (pd->cfg_cache)
+		rev_class = pd->cfg_cache->rev_class;
+	else
+		pci_cfg_read32(phb, pd->bdfn, PCI_CFG_REV_ID, &rev_class);
 	pci_cfg_read8(phb, pd->bdfn, PCI_CFG_INT_PIN, &intpin);
 	is_pcie = pci_has_cap(pd, PCI_CFG_CAP_ID_EXP, false);
 
@@ -1572,8 +1945,6 @@ static void __noinline pci_add_one_device_node(struct phb *phb,
 	 */
 	dt_add_property_cells(np, "reg", pd->bdfn << 8, 0, 0, 0, 0);
 
-	/* Print summary info about the device */
-	pci_print_summary_line(phb, pd, np, rev_class, cname);
 	if (!pd->is_bridge)
 		return;
 
@@ -1614,26 +1985,58 @@ static void __noinline pci_add_one_device_node(struct phb *phb,
 				0xf0000000, 0x0);
 }
 
-void __noinline pci_add_device_nodes(struct phb *phb,
-				     struct list_head *list,
-				     struct dt_node *parent_node,
-				     struct pci_lsi_state *lstate,
-				     uint8_t swizzle)
+static void __noinline __pci_add_device_nodes(struct phb *phb,
+					      struct list_head *list,
+					      struct dt_node *parent_node,
+					      struct pci_lsi_state *lstate,
+					      uint8_t swizzle)
 {
 	struct pci_device *pd;
+	uint32_t reads;
 
 	/* Add all child devices */
 	list_for_each(list, pd, link) {
+		reads = phb->cfg_reads;
 		pci_add_one_device_node(phb, pd, parent_node,
 					lstate, swizzle);
+		pd->cfg_reads += phb->cfg_reads - reads;
+		PCIDBG(phb, pd->bdfn, "%u config reads to enumerate\n",
+		       pd->cfg_reads);
+
+		/* That was the last user of the config cache */
+		pci_cfg_cache_free(pd);
 		if (list_empty(&pd->children))
 			continue;
 
-		pci_add_device_nodes(phb, &pd->children,
-				     pd->dn, lstate, swizzle);
+		__pci_add_device_nodes(phb, &pd->children,
+				       pd->dn, lstate, swizzle);
 	}
 }
 
+/* Print summary info about the devices, in device tree order */
+static void pci_print_summary(struct phb *phb, struct list_head *list)
+{
+	struct pci_device *pd;
+
+	list_for_each(list, pd, link) {
+		if (!pd->dn)
+			continue;
+
+		pci_print_summary_line(phb, pd);
+		pci_print_summary(phb, &pd->children);
+	}
+}
+
+void pci_add_device_nodes(struct phb *phb,
+			  struct list_head *list,
+			  struct dt_node *parent_node,
+			  struct pci_lsi_state *lstate,
+			  uint8_t swizzle)
+{
+	__pci_add_device_nodes(phb, list, parent_node, lstate, swizzle);
+	pci_print_summary(phb, list);
+}
+
 static void pci_do_jobs(void (*fn)(void *))
 {
 	struct cpu_job **jobs;
@@ -1666,6 +2069,53 @@ static void pci_do_jobs(void (*fn)(void *))
 	free(jobs);
 }
 
+static void pci_add_phb_nodes(void *data)
+{
+	struct phb *phb = data;
+
+	__pci_add_device_nodes(phb, &phb->devices, phb->dt_node,
+			       &phb->lstate, 0);
+}
+
+/* Give new nodes below @np phandles in device tree order */
+static void pci_renumber_phandles(struct dt_node *np, u32 first_new)
+{
+	struct dt_node *child;
+
+	dt_for_each_child(np, child) {
+		if (child->phandle > first_new)
+			child->phandle = new_phandle();
+		pci_renumber_phandles(child, first_new);
+	}
+}
+
+/*
+ * Create the device nodes of each PHB from its own job, they mostly
+ * wait on config space reads. The subtree of a PHB node is only ever
+ * touched by the job of that PHB.
+ *
+ * Phandles are handed out as the CPUs race, so they are given new
+ * ones afterwards, PHB after PHB in device tree order, to keep them
+ * the same from one boot to the next. The summary is printed from
+ * that same walk so the lines of different PHBs don't interleave.
+ */
+static void pci_add_nodes(void)
+{
+	u32 first_new = get_last_phandle();
+	unsigned int i;
+
+	pci_do_jobs(pci_add_phb_nodes);
+
+	for (i = 0; i < ARRAY_SIZE(phbs); i++) {
+		if (!phbs[i])
+			continue;
+
+		if (phbs[i]->dt_node)
+			pci_renumber_phandles(phbs[i]->dt_node, first_new);
+		pci_print_summary(phbs[i], &phbs[i]->devices);
+	}
+}
+
 static void __pci_init_slots(void)
 {
 	unsigned int i;
@@ -1684,7 +2134,7 @@ static void __pci_init_slots(void)
 		platform.pre_pci_fixup();
 
 	prlog(PR_NOTICE, "PCI: Resetting PHBs and training links...\n");
-	pci_do_jobs(pci_reset_phb);
+	pci_reset_phbs();
 
 	prlog(PR_NOTICE, "PCI: Probing slots...\n");
 	pci_do_jobs(pci_scan_phb);
@@ -1693,14 +2143,7 @@ static void __pci_init_slots(void)
 		platform.pci_probe_complete();
 
 	prlog(PR_NOTICE, "PCI Summary:\n");
-
-	for (i = 0; i < ARRAY_SIZE(phbs); i++) {
-		if (!phbs[i])
-			continue;
-
-		pci_add_device_nodes(phbs[i], &phbs[i]->devices,
-				     phbs[i]->dt_node, &phbs[i]->lstate, 0);
-	}
+	pci_add_nodes();
 
 	/* PHB final fixup */
 	for (i = 0; i < ARRAY_SIZE(phbs); i++) {
@@ -1711,22 +2154,25 @@ static void __pci_init_slots(void)
 	}
 }
 
-static void __pci_reset(struct list_head *list)
+static void __pci_reset(struct phb *phb, struct list_head *list)
 {
 	struct pci_device *pd;
 	struct pci_cfg_reg_filter *pcrf;
 	int i;
 
 	while ((pd = list_pop(list, struct pci_device, link)) != NULL) {
-		__pci_reset(&pd->children);
+		__pci_reset(phb, &pd->children);
+		pci_index_del(phb, pd);
 		dt_free(pd->dn);
 		free(pd->slot);
 		while((pcrf = list_pop(&pd->pcrf, struct pci_cfg_reg_filter, link)) != NULL) {
 			free(pcrf);
 		}
+		free(pd->pcrf_table);
 		for(i=0; i < 64; i++)
 			if (pd->cap[i].free_func)
 				pd->cap[i].free_func(pd->cap[i].data);
+		pci_cfg_cache_free(pd);
 		free(pd);
 	}
 }
@@ -1741,7 +2187,7 @@ int64_t pci_reset(void)
 		struct phb *phb = phbs[i];
 		if (!phb)
 			continue;
-		__pci_reset(&phb->devices);
+		__pci_reset(phb, &phb->devices);
 
 		pci_slot_set_state(phb->slot, PCI_SLOT_STATE_CRESET_START);
 	}
@@ -1809,23 +2255,11 @@ struct pci_device *pci_walk_dev(struct phb *phb,
 	return __pci_walk_dev(phb, &phb->devices, cb, userdata);
 }
 
-static int __pci_find_dev(struct phb *phb,
-			  struct pci_device *pd, void *userdata)
-{
-	uint16_t bdfn = *((uint16_t *)userdata);
-
-	if (!phb || !pd)
-		return 0;
-
-	if (pd->bdfn == bdfn)
-		return 1;
-
-	return 0;
-}
-
 struct pci_device *pci_find_dev(struct phb *phb, uint16_t bdfn)
 {
-	return pci_walk_dev(phb, NULL, __pci_find_dev, &bdfn);
+	struct pci_device **bus = phb->dev_index[PCI_BUS_NUM(bdfn)];
+
+	return bus ? bus[bdfn & 0xff] : NULL;
 }
 
 static int __pci_restore_bridge_buses(struct phb *phb,
@@ -1883,23 +2317,93 @@ void pci_restore_slot_bus_configs(struct pci_slot *slot)
 			     slot->phb->ops->device_init, NULL);
 }
 
+/*
+ * Insert a filter in a sorted table. Filters are added while the
+ * device is set up, before anything else can issue config accesses
+ * to it, so the old table can go right away.
+ */
+bool pci_cfg_filter_table_add(struct pci_cfg_filter_table **table,
+			      struct pci_cfg_reg_filter *pcrf)
+{
+	struct pci_cfg_filter_table *old = *table, *t;
+	uint32_t nr = old ? old->nr : 0;
+	uint32_t i;
+
+	t = zalloc(sizeof(*t) + (nr + 1) * sizeof(t->ents[0]));
+	if (!t)
+		return false;
+
+	t->nr = nr + 1;
+	t->max_len = old ? old->max_len : 0;
+	if (pcrf->len > t->max_len)
+		t->max_len = pcrf->len;
+
+	/* Filters are never removed, so the count orders them by age */
+	for (i = nr; i > 0 && old->ents[i - 1].pcrf->start > pcrf->start; i--)
+		t->ents[i] = old->ents[i - 1];
+	t->ents[i].pcrf = pcrf;
+	t->ents[i].seq = nr;
+	if (i)
+		memcpy(t->ents, old->ents, i * sizeof(t->ents[0]));
+
+	lwsync();
+	*table = t;
+	free(old);
+
+	return true;
+}
+
+/* Index of the last filter starting at or below @offset, -1 if none */
+int pci_cfg_filter_table_search(const struct pci_cfg_filter_table *t,
+				uint32_t offset)
+{
+	int lo = 0, hi, mid;
+
+	if (!t)
+		return -1;
+
+	hi = t->nr;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (t->ents[mid].pcrf->start <= offset)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo - 1;
+}
+
 struct pci_cfg_reg_filter *pci_find_cfg_reg_filter(struct pci_device *pd,
 						   uint32_t start, uint32_t len)
 {
-	struct pci_cfg_reg_filter *pcrf;
+	struct pci_cfg_filter_table *t = pd->pcrf_table;
+	struct pci_cfg_reg_filter *pcrf, *found = NULL;
+	uint32_t seq = 0;
+	int i;
 
 	/* Check on the cached range, which contains holes */
 	if ((start + len) <= pd->pcrf_start ||
 	    pd->pcrf_end <= start)
 		return NULL;
 
-	list_for_each(&pd->pcrf, pcrf, link) {
-		if (start >= pcrf->start &&
-		    (start + len) <= (pcrf->start + pcrf->len))
-			return pcrf;
+	/*
+	 * Filters can overlap, look at the ones starting below us until
+	 * they're too far away to cover the access, and pick the one
+	 * that was added first like a walk of the list would
+	 */
+	for (i = pci_cfg_filter_table_search(t, start); i >= 0; i--) {
+		pcrf = t->ents[i].pcrf;
+		if ((pcrf->start + t->max_len) < (start + len))
+			break;
+		if ((start + len) <= (pcrf->start + pcrf->len) &&
+		    (!found || t->ents[i].seq < seq)) {
+			found = pcrf;
+			seq = t->ents[i].seq;
+		}
 	}
 
-	return NULL;
+	return found;
 }
 
 static bool pci_device_has_cfg_reg_filters(struct phb *phb, uint16_t bdfn)
@@ -1952,6 +2456,10 @@ struct pci_cfg_reg_filter *pci_add_cfg_reg_filter(struct pci_device *pd,
 	pcrf->len = len;
 	pcrf->func = func;
 	pcrf->data = (uint8_t *)(pcrf + 1);
+	if (!pci_cfg_filter_table_add(&pd->pcrf_table, pcrf)) {
+		free(pcrf);
+		return NULL;
+	}
 
 	if (start < pd->pcrf_start)
 		pd->pcrf_start = start;
@@ -0,0 +1,68 @@
+// SPDX-License-Identifier: Apache-2.0 OR GPL-2.0-or-later
+/*
+ * Copyright 2026 IBM Corp.
+ *
+ * Builds core/pci.c for the tests, include it instead of pci.c.
+ * Define PCI_TEST_TB to the timebase the test wants mftb() to see,
+ * it doesn't move otherwise, and PCI_TEST_QUIET to drop the logs.
+ */
+
+#ifndef __PCI_STUBS_H
+#define __PCI_STUBS_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#define __TEST__
+#include <skiboot.h>
+#include <lock.h>
+
+#ifndef PCI_TEST_TB
+#define PCI_TEST_TB	0ul
+#endif
+
+#define sync()
+#define lwsync()
+#define zalloc(bytes) calloc((bytes), 1)
+#define mftb()		PCI_TEST_TB
+
+#include <io.h>
+
+void lock_caller(struct lock *l, const char *caller)
+{
+	(void)caller;
+	(void)l;
+}
+
+void unlock(struct lock *l)
+{
+	(void)l;
+}
+
+static inline int ilog2(unsigned long val)
+{
+	return 63 - __builtin_clzl(val);
+}
+
+#ifdef PCI_TEST_QUIET
+#undef prlog
+#define prlog(l, f, ...)	do { if (0) printf(f, ##__VA_ARGS__); } while (0)
+#endif
+
+#include "../pci.c"
+
+struct platform platform;
+unsigned long tb_hz = 512000000;
+u32 last_phandle;
+
+/* None of our devices have a node */
+void dt_free(struct dt_node *node)
+{
+	assert(!node);
+}
+
+#endif /* __PCI_STUBS_H */
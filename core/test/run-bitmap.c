@@ -8,6 +8,82 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <time.h>
+
+/* Bit-by-bit reference version of the word-at-a-time searches */
+static int naive_find(bitmap_t map, unsigned int start, unsigned int count,
+		      bool value)
+{
+	unsigned int i;
+
+	for (i = start; i < start + count; i++)
+		if (bitmap_tst_bit(map, i) == value)
+			return i;
+	return -1;
+}
+
+#define BIG_BITS	(1 << 20)
+
+static unsigned long elapsed_ns(struct timespec *start)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_sec - start->tv_sec) * 1000000000ul +
+		end.tv_nsec - start->tv_nsec;
+}
+
+static void test_ranges(void)
+{
+	bitmap_elem_t *map = malloc(BITMAP_BYTES(BIG_BITS));
+	unsigned int i, start, count;
+
+	/* Mostly full map, with runs of free bits here and there, like
+	 * an IRQ allocation map.
+	 */
+	srandom(1);
+	for (i = 0; i < BITMAP_ELEMS(BIG_BITS); i++)
+		map[i] = random() % 4 ? -1ul : (unsigned long)random() << 32;
+
+	for (i = 0; i < 20000; i++) {
+		start = random() % BIG_BITS;
+		count = random() % (BIG_BITS - start);
+		if (i & 1)
+			count %= 300;
+
+		assert(bitmap_find_zero_bit(map, start, count) ==
+		       naive_find(map, start, count, false));
+		assert(bitmap_find_one_bit(map, start, count) ==
+		       naive_find(map, start, count, true));
+	}
+	assert(bitmap_find_zero_bit(map, 5, 0) == -1);
+
+	free(map);
+}
+
+static void bench(void)
+{
+	bitmap_elem_t *map = malloc(BITMAP_BYTES(BIG_BITS));
+	unsigned long ns, naive_ns;
+	struct timespec start;
+	int r1, r2;
+
+	/* Everything busy except the very last bit */
+	memset(map, 0xff, BITMAP_BYTES(BIG_BITS));
+	bitmap_clr_bit(map, BIG_BITS - 1);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	r1 = bitmap_find_zero_bit(map, 0, BIG_BITS);
+	ns = elapsed_ns(&start);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	r2 = naive_find(map, 0, BIG_BITS, false);
+	naive_ns = elapsed_ns(&start);
+	assert(r1 == r2 && r1 == BIG_BITS - 1);
+	printf("zero bit search over %u bits: %lu us (bit-by-bit %lu us)\n",
+	       BIG_BITS, ns / 1000, naive_ns / 1000);
+
+	free(map);
+}
 
 int main(void)
 {
@@ -76,5 +152,8 @@ int main(void)
 
 	free(map);
 
+	test_ranges();
+	bench();
+
 	return 0;
 }
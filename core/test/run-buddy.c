@@ -7,6 +7,8 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
 
 static void *zalloc(size_t size)
 {
@@ -18,6 +20,138 @@ static void *zalloc(size_t size)
 
 #define BUDDY_ORDER	8
 
+/*
+ * Alloc/free churn at the orders KVM guests hit the XIVE VP allocator
+ * with: a 128k entry buddy with the HW thread range reserved, and a
+ * few thousand live blocks of 2 to 64 entries being recycled.
+ */
+#define CHURN_ORDER	17
+#define CHURN_LIVE	4096
+#define CHURN_ROUNDS	200000
+
+static void test_churn(void)
+{
+	static int live_idx[CHURN_LIVE];
+	static unsigned char live_order[CHURN_LIVE];
+	static unsigned char owned[1 << CHURN_ORDER];
+	struct timespec start, end;
+	unsigned int i, j, fails = 0;
+	unsigned long ns;
+	struct buddy *b;
+	int idx;
+
+	b = buddy_create(CHURN_ORDER);
+	assert(b);
+	assert(buddy_reserve(b, 0x80, 7));
+
+	for (i = 0; i < CHURN_LIVE; i++)
+		live_idx[i] = -1;
+	memset(owned, 0, sizeof(owned));
+	srandom(1);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < CHURN_ROUNDS; i++) {
+		unsigned int slot = random() % CHURN_LIVE;
+		unsigned int order;
+
+		if (live_idx[slot] >= 0) {
+			order = live_order[slot];
+			for (j = 0; j < (1u << order); j++) {
+				assert(owned[live_idx[slot] + j]);
+				owned[live_idx[slot] + j] = 0;
+			}
+			buddy_free(b, live_idx[slot], order);
+			live_idx[slot] = -1;
+			continue;
+		}
+
+		/* Mostly small guests, the odd big one */
+		order = 1 + (random() % 100 < 90 ? random() % 3 : random() % 5);
+		idx = buddy_alloc(b, order);
+		if (idx < 0) {
+			fails++;
+			continue;
+		}
+		assert(!(idx & ((1 << order) - 1)));
+		assert(idx + (1 << order) <= 0x80 || idx >= 0x100);
+		for (j = 0; j < (1u << order); j++) {
+			assert(!owned[idx + j]);
+			owned[idx + j] = 1;
+		}
+		live_idx[slot] = idx;
+		live_order[slot] = order;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	ns = (end.tv_sec - start.tv_sec) * 1000000000ul +
+		end.tv_nsec - start.tv_nsec;
+	printf("buddy churn: %u ops at order %u in %lu us (%lu ns/op), %u failed\n",
+	       CHURN_ROUNDS, CHURN_ORDER, ns / 1000, ns / CHURN_ROUNDS, fails);
+	assert(fails == 0);
+
+	/* Everything coalesces back once the guests are gone */
+	for (i = 0; i < CHURN_LIVE; i++)
+		if (live_idx[i] >= 0)
+			buddy_free(b, live_idx[i], live_order[i]);
+	buddy_free(b, 0x80, 7);
+	assert(buddy_alloc(b, CHURN_ORDER) == 0);
+
+	buddy_destroy(b);
+}
+
+/*
+ * Allocation speed on a large buddy: fill the bottom of the tree with
+ * small blocks so that the free nodes of the low orders sit further
+ * and further away from the start of their level.
+ */
+#define BIG_ORDER	22
+#define BIG_ALLOCS	(1 << 15)
+
+static void test_big(void)
+{
+	struct timespec start, end;
+	unsigned long ns;
+	struct buddy *b;
+	unsigned int i;
+	int idx;
+
+	b = buddy_create(BIG_ORDER);
+	assert(b);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < BIG_ALLOCS; i++) {
+		idx = buddy_alloc(b, i & 1);
+		assert(idx >= 0);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	ns = (end.tv_sec - start.tv_sec) * 1000000000ul +
+		end.tv_nsec - start.tv_nsec;
+	printf("buddy fill: %u allocs at order %u in %lu us (%lu ns/op)\n",
+	       BIG_ALLOCS, BIG_ORDER, ns / 1000, ns / BIG_ALLOCS);
+
+	/* Now keep allocating and freeing at the end of the used range */
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < BIG_ALLOCS; i++) {
+		idx = buddy_alloc(b, 0);
+		assert(idx >= BIG_ALLOCS);
+		buddy_free(b, idx, 0);
+		idx = buddy_alloc(b, 3);
+		assert(idx >= 0);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	ns = (end.tv_sec - start.tv_sec) * 1000000000ul +
+		end.tv_nsec - start.tv_nsec;
+	printf("buddy frontier: %u alloc/free at order %u in %lu us (%lu ns/op)\n",
+	       BIG_ALLOCS, BIG_ORDER, ns / 1000, ns / BIG_ALLOCS);
+
+	/* Reset gives us the whole tree back */
+	buddy_reset(b);
+	assert(buddy_alloc(b, BIG_ORDER) == 0);
+	assert(buddy_alloc(b, 0) < 0);
+
+	buddy_destroy(b);
+}
+
 int main(void)
 {
 	struct buddy *b;
@@ -69,5 +203,8 @@ int main(void)
 	assert(!bitmap_tst_bit(b->map, 1));
 
 	buddy_destroy(b);
+
+	test_churn();
+	test_big();
 	return 0;
 }
@@ -0,0 +1,174 @@
+// SPDX-License-Identifier: Apache-2.0 OR GPL-2.0-or-later
+/*
+ * Copyright 2026 IBM Corp.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#define __TEST__
+#include <skiboot.h>
+#include <lock.h>
+
+#define sync()
+#define lwsync()
+#define zalloc(bytes) calloc((bytes), 1)
+
+/* No ICP to poke at */
+#include <io.h>
+#undef in_be32
+#define in_be32(addr)		({ (void)(addr); 0; })
+#define out_8(addr, val)	do { (void)(addr); (void)(val); } while (0)
+#define out_be32(addr, val)	do { (void)(addr); (void)(val); } while (0)
+
+void lock_caller(struct lock *l, const char *caller)
+{
+	(void)caller;
+	(void)l;
+}
+
+void unlock(struct lock *l)
+{
+	(void)l;
+}
+
+/* Keep quiet about the hundreds of sources we register */
+#undef prlog
+#define prlog(l, f, ...)	do { } while (0)
+
+#include "../interrupts.c"
+
+struct debug_descriptor debug_descriptor;
+enum proc_gen proc_gen = proc_gen_unknown;
+unsigned long top_of_ram;
+struct dt_node *dt_root;
+struct dt_node *opal_node;
+
+/* Us and one other CPU */
+static struct cpu_thread cpus[2];
+
+struct cpu_thread *first_cpu(void)
+{
+	return &cpus[0];
+}
+
+struct cpu_thread *next_cpu(struct cpu_thread *cpu)
+{
+	return cpu == &cpus[0] ? &cpus[1] : NULL;
+}
+
+/* A few hundred sources, like a big system with lots of PHBs */
+#define NR_SOURCES	512
+#define SRC_SIZE	0x800
+#define LOOKUPS		(1 << 18)
+
+static struct irq_source_ops ops;
+static struct irq_source catch_all;
+
+static unsigned long elapsed_ns(struct timespec *start)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_sec - start->tv_sec) * 1000000000ul +
+		end.tv_nsec - start->tv_nsec;
+}
+
+/* What the lists used to do, for comparison */
+static struct irq_source *list_find_source(uint32_t isn)
+{
+	struct irq_source *is;
+
+	list_for_each(&irq_sources, is, link)
+		if (isn >= is->start && isn < is->end)
+			return is;
+	list_for_each(&irq_sources2, is, link)
+		if (isn >= is->start && isn < is->end)
+			return is;
+	return NULL;
+}
+
+int main(void)
+{
+	struct timespec start;
+	struct irq_source *is;
+	unsigned long ns, list_ns;
+	unsigned int i, s;
+	uint32_t isn;
+
+	assert(!irq_find_source(0));
+
+	/* Register in a scrambled order, leaving every 8th slot empty */
+	for (i = 0; i < NR_SOURCES; i++) {
+		s = (i * 37) % NR_SOURCES;
+		if (s % 8 != 7)
+			register_irq_source(&ops, NULL, s * SRC_SIZE, SRC_SIZE - 4);
+	}
+
+	/* And a secondary source covering everything, behind the others */
+	catch_all.start = 0;
+	catch_all.end = NR_SOURCES * SRC_SIZE;
+	catch_all.ops = &ops;
+	__register_irq_source(&catch_all, true);
+
+	assert(irq_index->nr == NR_SOURCES - NR_SOURCES / 8 + 1);
+	for (i = 1; i < irq_index->nr_primary; i++)
+		assert(irq_index->ents[i - 1].start < irq_index->ents[i].start);
+
+	for (isn = 0; isn < NR_SOURCES * SRC_SIZE + 16; isn += 3)
+		assert(irq_find_source(isn) == list_find_source(isn));
+
+	is = irq_find_source(5 * SRC_SIZE + 1);
+	assert(is && is != &catch_all && is->start == 5 * SRC_SIZE);
+	assert(irq_find_source(5 * SRC_SIZE + SRC_SIZE - 2) == &catch_all);
+	assert(irq_find_source(7 * SRC_SIZE) == &catch_all);
+	assert(!irq_find_source(NR_SOURCES * SRC_SIZE));
+
+	/* Unregistering takes it out of the index */
+	unregister_irq_source(5 * SRC_SIZE, SRC_SIZE - 4);
+	assert(irq_find_source(5 * SRC_SIZE + 1) == &catch_all);
+	assert(irq_index->nr == NR_SOURCES - NR_SOURCES / 8);
+	register_irq_source(&ops, NULL, 5 * SRC_SIZE, SRC_SIZE - 4);
+	assert(!irq_index_retired);
+
+	/* Once booted, old copies wait for the other CPU to leave OPAL */
+	__this_cpu = &cpus[0];
+	debug_descriptor.state_flags |= OPAL_BOOT_COMPLETE;
+	cpus[0].in_opal_call = 1;
+	cpus[1].in_opal_call = 1;
+	unregister_irq_source(5 * SRC_SIZE, SRC_SIZE - 4);
+	register_irq_source(&ops, NULL, 5 * SRC_SIZE, SRC_SIZE - 4);
+	assert(irq_index_retired && irq_index_retired->retired);
+	assert(!irq_index_retired->retired->retired);
+	assert(irq_find_source(5 * SRC_SIZE + 1) != &catch_all);
+
+	cpus[1].in_opal_call = 0;
+	unregister_irq_source(5 * SRC_SIZE, SRC_SIZE - 4);
+	assert(!irq_index_retired);
+	register_irq_source(&ops, NULL, 5 * SRC_SIZE, SRC_SIZE - 4);
+	assert(!irq_index_retired);
+
+	/* Lookup cost, at the end of the range where the lists hurt most */
+	srandom(1);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < LOOKUPS; i++)
+		assert(irq_find_source(NR_SOURCES * SRC_SIZE - 1 -
+				       random() % (SRC_SIZE * 64)));
+	ns = elapsed_ns(&start);
+
+	srandom(1);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < LOOKUPS / 16; i++)
+		assert(list_find_source(NR_SOURCES * SRC_SIZE - 1 -
+					random() % (SRC_SIZE * 64)));
+	list_ns = elapsed_ns(&start) * 16;
+
+	printf("%u sources: %lu ns/lookup (lists: %lu ns/lookup)\n",
+	       irq_index->nr, ns / LOOKUPS, list_ns / LOOKUPS);
+
+	return 0;
+}
@@ -0,0 +1,203 @@
+// SPDX-License-Identifier: Apache-2.0 OR GPL-2.0-or-later
+/*
+ * Copyright 2026 IBM Corp.
+ */
+
+#include "pci-stubs.h"
+
+/*
+ * A PCIe endpoint with a few capabilities in each list, the ones
+ * enumeration looks for are at the end.
+ */
+#define BDFN		0x0100
+#define VDID		0x12341014
+#define CAP_ID_MSI	0x05
+#define CAP_ID_HT	0x08
+#define CAP_ID_MSIX	0x11
+#define ECAP_ID_ACS	0x0d
+#define ECAP_ID_ATS	0x0f
+
+static uint8_t cfg[4096];
+static unsigned int hw_reads;
+
+static void put_le16(uint32_t off, uint16_t val)
+{
+	cfg[off] = val & 0xff;
+	cfg[off + 1] = val >> 8;
+}
+
+static void put_le32(uint32_t off, uint32_t val)
+{
+	put_le16(off, val & 0xffff);
+	put_le16(off + 2, val >> 16);
+}
+
+static void fake_device(void)
+{
+	memset(cfg, 0, sizeof(cfg));
+	put_le32(PCI_CFG_VENDOR_ID, VDID);
+	put_le16(PCI_CFG_STAT, PCI_CFG_STAT_CAP);
+	put_le32(PCI_CFG_REV_ID, 0x02000003);
+	cfg[PCI_CFG_CAP] = 0x40;
+
+	put_le16(0x40, 0x5000 | PCI_CFG_CAP_ID_VENDOR);
+	put_le16(0x50, 0x6000 | CAP_ID_MSI);
+	put_le16(0x60, 0x7000 | CAP_ID_MSIX);
+	put_le16(0x70, 0x8000 | PCI_CFG_CAP_ID_PM);
+	put_le16(0x80, 0x0000 | PCI_CFG_CAP_ID_EXP);
+	put_le16(0x80 + PCICAP_EXP_CAPABILITY_REG, 0x0002);
+	put_le32(0x80 + PCICAP_EXP_DEVCAP, 0x00000001);
+
+	put_le32(0x100, 0x14010000 | PCIECAP_ID_SRIOV);
+	put_le32(0x140, 0x18010000 | ECAP_ID_ACS);
+	put_le32(0x180, 0x00020000 | PCIECAP_ID_AER);
+}
+
+static int64_t fake_read(struct phb *phb __unused, uint32_t bdfn,
+			 uint32_t offset, uint32_t size, void *data)
+{
+	uint32_t val = 0xffffffff;
+	unsigned int i;
+
+	hw_reads++;
+	if (bdfn == BDFN)
+		for (i = 0, val = 0; i < size; i++)
+			val |= (uint32_t)cfg[offset + i] << (8 * i);
+
+	switch (size) {
+	case 1: *(uint8_t *)data = val; break;
+	case 2: *(uint16_t *)data = val; break;
+	default: *(uint32_t *)data = val; break;
+	}
+	return OPAL_SUCCESS;
+}
+
+static int64_t fake_write(struct phb *phb __unused, uint32_t bdfn,
+			  uint32_t offset, uint32_t size, uint32_t val)
+{
+	unsigned int i;
+
+	/* The vendor/device ID is read-only */
+	if (bdfn != BDFN || offset == PCI_CFG_VENDOR_ID)
+		return OPAL_SUCCESS;
+	for (i = 0; i < size; i++)
+		cfg[offset + i] = val >> (8 * i);
+	return OPAL_SUCCESS;
+}
+
+#define FAKE_CFG(sz, type)						\
+static int64_t fake_read##sz(struct phb *phb, uint32_t bdfn,		\
+			     uint32_t offset, type *data)		\
+{									\
+	return fake_read(phb, bdfn, offset, sizeof(type), data);	\
+}									\
+static int64_t fake_write##sz(struct phb *phb, uint32_t bdfn,		\
+			      uint32_t offset, type data)		\
+{									\
+	return fake_write(phb, bdfn, offset, sizeof(type), data);	\
+}
+FAKE_CFG(8, uint8_t)
+FAKE_CFG(16, uint16_t)
+FAKE_CFG(32, uint32_t)
+
+static struct phb_ops ops = {
+	.cfg_read8	= fake_read8,
+	.cfg_read16	= fake_read16,
+	.cfg_read32	= fake_read32,
+	.cfg_write8	= fake_write8,
+	.cfg_write16	= fake_write16,
+	.cfg_write32	= fake_write32,
+};
+static struct phb phb = { .ops = &ops };
+
+/* The lookups done while a device is enumerated and its node created */
+static unsigned int enumerate_lookups(void)
+{
+	unsigned int reads = hw_reads;
+	uint8_t ver;
+
+	assert(pci_find_cap(&phb, BDFN, PCI_CFG_CAP_ID_EXP) == 0x80);
+	assert(pci_find_cap(&phb, BDFN, PCI_CFG_CAP_ID_PM) == 0x70);
+	assert(pci_find_cap(&phb, BDFN, CAP_ID_MSIX) == 0x60);
+	assert(pci_find_cap(&phb, BDFN, CAP_ID_HT) ==
+	       OPAL_UNSUPPORTED);
+	assert(pci_find_ecap(&phb, BDFN, PCIECAP_ID_AER, &ver) == 0x180);
+	assert(ver == 2);
+	assert(pci_find_ecap(&phb, BDFN, ECAP_ID_ACS, NULL) == 0x140);
+	assert(pci_find_ecap(&phb, BDFN, ECAP_ID_ATS, NULL) ==
+	       OPAL_UNSUPPORTED);
+
+	return hw_reads - reads;
+}
+
+int main(void)
+{
+	struct pci_device *pd;
+	unsigned int cached, uncached, id;
+	uint8_t ver, cver;
+	int64_t pos;
+
+	list_head_init(&phb.devices);
+	fake_device();
+
+	/* The scan fills the cache and only walks each list once */
+	hw_reads = 0;
+	pd = __pci_scan_one(&phb, NULL, BDFN, VDID);
+	assert(pd && pd->cfg_cache && phb.cfg_caches == 1);
+	assert(pd->class == 0x020000);
+	assert(pd->dev_type == PCIE_TYPE_ENDPOINT);
+	assert(pci_cap(pd, PCI_CFG_CAP_ID_EXP, false) == 0x80);
+	assert(pci_cap(pd, PCIECAP_ID_AER, true) == 0x180);
+	assert(pci_cap(pd, PCI_CFG_CAP_ID_PM, false) == 0x70);
+	assert(pd->cfg_reads == hw_reads);
+	cached = enumerate_lookups();
+	printf("Scan: %u config reads, lookups after it: %u\n",
+	       pd->cfg_reads, cached);
+	assert(cached == 0);
+
+	/* It gives the same answers as the hardware for every ID */
+	for (id = 0; id < 0x100; id++) {
+		pci_cfg_cache_free(pd);
+		pos = pci_find_cap(&phb, BDFN, id);
+		pd->cfg_cache = zalloc(sizeof(struct pci_cfg_cache));
+		phb.cfg_caches++;
+		assert(pci_find_cap(&phb, BDFN, id) == pos);
+	}
+	for (id = 0; id < 0x100; id++) {
+		ver = cver = 0xff;
+		pci_cfg_cache_free(pd);
+		pos = pci_find_ecap(&phb, BDFN, id, &ver);
+		pd->cfg_cache = zalloc(sizeof(struct pci_cfg_cache));
+		phb.cfg_caches++;
+		assert(pci_find_ecap(&phb, BDFN, id, &cver) == pos);
+		assert(cver == ver);
+	}
+
+	/* Writes to registers it doesn't hold keep it */
+	enumerate_lookups();
+	pci_cfg_write16(&phb, BDFN, 0x80 + PCICAP_EXP_DEVCTL, 0x20);
+	pci_cfg_write32(&phb, BDFN, 0x180 + PCIECAP_AER_UE_STATUS, ~0u);
+	pci_cfg_write16(&phb, BDFN, PCI_CFG_CMD, PCI_CFG_CMD_MEM_EN);
+	assert(pd->cfg_cache && enumerate_lookups() == 0);
+
+	/* A write to one it holds drops it, and we go to the hardware */
+	pci_cfg_write16(&phb, BDFN, 0x60, 0x7000 | PCI_CFG_CAP_ID_VENDOR);
+	assert(!pd->cfg_cache && phb.cfg_caches == 0);
+	assert(pci_find_cap(&phb, BDFN, CAP_ID_MSIX) ==
+	       OPAL_UNSUPPORTED);
+	put_le16(0x60, 0x7000 | CAP_ID_MSIX);
+	uncached = enumerate_lookups();
+	printf("Lookups without the cache: %u\n", uncached);
+	assert(uncached > 10);
+
+	/* And so does a reset */
+	pd->cfg_cache = zalloc(sizeof(struct pci_cfg_cache));
+	phb.cfg_caches++;
+	__pci_reset(&phb, &phb.devices);
+	assert(phb.cfg_caches == 0);
+	assert(pci_find_cap(&phb, BDFN, PCI_CFG_CAP_ID_EXP) == 0x80);
+
+	free(phb.dev_index[PCI_BUS_NUM(BDFN)]);
+
+	return 0;
+}
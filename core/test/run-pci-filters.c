@@ -0,0 +1,223 @@
+// SPDX-License-Identifier: Apache-2.0 OR GPL-2.0-or-later
+/*
+ * Copyright 2026 IBM Corp.
+ */
+
+#include "pci-stubs.h"
+#include "../pci-virt.c"
+
+#define BDFN		0x0108
+#define FILTERS		48
+#define LOOKUPS		(1 << 20)
+
+static struct phb_ops ops;
+static struct phb phb = { .ops = &ops };
+static unsigned int calls;
+
+static int64_t count_filter(void *dev __unused,
+			    struct pci_cfg_reg_filter *pcrf __unused,
+			    uint32_t offset __unused, uint32_t len __unused,
+			    uint32_t *data, bool write)
+{
+	calls++;
+	if (!write)
+		*data = 0x5a;
+	return OPAL_SUCCESS;
+}
+
+static unsigned long elapsed_ns(struct timespec *start)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_sec - start->tv_sec) * 1000000000ul +
+		end.tv_nsec - start->tv_nsec;
+}
+
+/* What pci_find_cfg_reg_filter() used to do, for comparison */
+static struct pci_cfg_reg_filter *walk_find(struct list_head *list,
+					    uint32_t start, uint32_t len)
+{
+	struct pci_cfg_reg_filter *pcrf;
+
+	list_for_each(list, pcrf, link) {
+		if (start >= pcrf->start &&
+		    (start + len) <= (pcrf->start + pcrf->len))
+			return pcrf;
+	}
+
+	return NULL;
+}
+
+/* And pci_virt_find_filter() */
+static struct pci_cfg_reg_filter *walk_find_overlap(struct list_head *list,
+						    uint32_t start,
+						    uint32_t len)
+{
+	struct pci_cfg_reg_filter *pcrf;
+
+	list_for_each(list, pcrf, link) {
+		if (start < (pcrf->start + pcrf->len) &&
+		    (start + len) > pcrf->start)
+			return pcrf;
+	}
+
+	return NULL;
+}
+
+static void test_device_filters(void)
+{
+	struct pci_device *pd = zalloc(sizeof(*pd));
+	struct pci_cfg_reg_filter *pcrf, *outer;
+	struct timespec start;
+	unsigned long ns, walk_ns;
+	uint32_t off, len, data, i;
+
+	assert(pd);
+	pd->phb = &phb;
+	pd->bdfn = BDFN;
+	list_head_init(&pd->pcrf);
+	list_head_init(&pd->children);
+	list_add_tail(&phb.devices, &pd->link);
+	pci_index_add(&phb, pd);
+
+	/* Disjoint filters added out of order, some of them 1 byte */
+	for (i = 0; i < FILTERS; i++) {
+		off = 0x100 + ((i * 29) % FILTERS) * 0x40;
+		len = (i & 3) ? 0x10 : 1;
+		assert(pci_add_cfg_reg_filter(pd, off, len,
+					      PCI_REG_FLAG_READ,
+					      count_filter));
+	}
+	assert(pd->pcrf_table->nr == FILTERS);
+	for (i = 1; i < FILTERS; i++)
+		assert(pd->pcrf_table->ents[i - 1].pcrf->start <
+		       pd->pcrf_table->ents[i].pcrf->start);
+
+	/* Re-adding a covered range gives the existing one back */
+	pcrf = pci_find_cfg_reg_filter(pd, 0x844, 4);
+	assert(pcrf && pci_add_cfg_reg_filter(pd, 0x848, 4, 0, NULL) == pcrf);
+	assert(pd->pcrf_table->nr == FILTERS);
+
+	for (off = 0; off < 0x1000; off++)
+		for (len = 1; len <= 4; len <<= 1)
+			assert(pci_find_cfg_reg_filter(pd, off, len) ==
+			       walk_find(&pd->pcrf, off, len));
+
+	/* A bigger filter over one that was there first */
+	pcrf = pci_add_cfg_reg_filter(pd, 0xfc0, 0x40, PCI_REG_FLAG_READ,
+				      count_filter);
+	outer = pci_add_cfg_reg_filter(pd, 0xf80, 0x80, PCI_REG_FLAG_READ,
+				       count_filter);
+	assert(outer && pcrf && outer != pcrf);
+	assert(pci_find_cfg_reg_filter(pd, 0xfc0, 4) == pcrf);
+	assert(pci_find_cfg_reg_filter(pd, 0xfbc, 4) == outer);
+
+	/* And one with the same start, the oldest still wins */
+	pcrf = pci_add_cfg_reg_filter(pd, 0xf80, 0x100, PCI_REG_FLAG_READ,
+				      count_filter);
+	assert(pcrf && pcrf != outer);
+	assert(pci_find_cfg_reg_filter(pd, 0xf80, 4) == outer);
+
+	for (off = 0; off < 0x1000; off++)
+		for (len = 1; len <= 4; len <<= 1)
+			assert(pci_find_cfg_reg_filter(pd, off, len) ==
+			       walk_find(&pd->pcrf, off, len));
+
+	/* Partly overlapping, the older one wins where they both cover */
+	pcrf = pci_add_cfg_reg_filter(pd, 0x08, 0x10, PCI_REG_FLAG_READ,
+				      count_filter);
+	outer = pci_add_cfg_reg_filter(pd, 0x10, 0x20, PCI_REG_FLAG_READ,
+				       count_filter);
+	assert(outer && pcrf && outer != pcrf);
+	assert(pci_find_cfg_reg_filter(pd, 0x12, 2) == pcrf);
+	assert(pci_find_cfg_reg_filter(pd, 0x16, 4) == outer);
+
+	for (off = 0; off < 0x1000; off++)
+		for (len = 1; len <= 4; len <<= 1)
+			assert(pci_find_cfg_reg_filter(pd, off, len) ==
+			       walk_find(&pd->pcrf, off, len));
+
+	/* Dispatch */
+	calls = 0;
+	data = 0;
+	assert(pci_handle_cfg_filters(&phb, BDFN, 0x844, 4, &data, false) ==
+	       OPAL_SUCCESS);
+	assert(calls == 1 && data == 0x5a);
+	assert(pci_handle_cfg_filters(&phb, BDFN, 0x844, 4, &data, true) ==
+	       OPAL_PARTIAL);
+	assert(pci_handle_cfg_filters(&phb, BDFN, 0x0fc, 4, &data, false) ==
+	       OPAL_PARTIAL);
+	assert(pci_handle_cfg_filters(&phb, BDFN + 1, 0x844, 4, &data, false)
+	       == OPAL_PARTIAL);
+	assert(calls == 1);
+
+	/* Lookup cost for an access that hits the last filter */
+	off = 0x100 + (FILTERS - 1) * 0x40;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < LOOKUPS; i++)
+		assert(pci_find_cfg_reg_filter(pd, off, 1));
+	ns = elapsed_ns(&start);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < LOOKUPS / 16; i++)
+		assert(walk_find(&pd->pcrf, off, 1));
+	walk_ns = elapsed_ns(&start) * 16;
+
+	printf("%u filters: %lu ns/lookup (walk: %lu ns/lookup)\n",
+	       pd->pcrf_table->nr, ns / LOOKUPS, walk_ns / LOOKUPS);
+
+	__pci_reset(&phb, &phb.devices);
+	free(phb.dev_index[PCI_BUS_NUM(BDFN)]);
+}
+
+static void test_virt_filters(void)
+{
+	struct pci_virt_device *pvd;
+	struct pci_cfg_reg_filter *pcrf;
+	uint32_t off, len, i;
+
+	pvd = pci_virt_add_device(&phb, BDFN, 0x1000, NULL);
+	assert(pvd);
+
+	for (i = 0; i < FILTERS; i++) {
+		off = 0x40 + ((i * 29) % FILTERS) * 0x50;
+		len = (i & 1) ? 0x20 : 6;
+		assert(pci_virt_add_filter(pvd, off, len, PCI_REG_FLAG_READ,
+					   count_filter, NULL));
+	}
+
+	/* Overlapping ones are refused */
+	assert(!pci_virt_add_filter(pvd, 0x3e, 4, PCI_REG_FLAG_READ,
+				    count_filter, NULL));
+	assert(!pci_virt_add_filter(pvd, 0x44, 0x100, PCI_REG_FLAG_READ,
+				    count_filter, NULL));
+	assert(pvd->pcrf_table->nr == FILTERS);
+
+	for (off = 0; off < 0x1000; off++)
+		for (len = 1; len <= 4; len <<= 1)
+			assert(pci_virt_find_filter(pvd, off, len) ==
+			       walk_find_overlap(&pvd->pcrf, off, len));
+
+	list_del(&pvd->node);
+	while ((pcrf = list_pop(&pvd->pcrf, struct pci_cfg_reg_filter, link)))
+		free(pcrf);
+	free(pvd->pcrf_table);
+	free(pvd->config[0]);
+	free(pvd);
+}
+
+int main(void)
+{
+	list_head_init(&phb.devices);
+	list_head_init(&phb.virt_devices);
+	phb.filter_map = zalloc(BITMAP_BYTES(0x10000));
+	assert(phb.filter_map);
+
+	test_device_filters();
+	test_virt_filters();
+
+	free(phb.filter_map);
+
+	return 0;
+}
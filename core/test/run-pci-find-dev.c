@@ -0,0 +1,132 @@
+// SPDX-License-Identifier: Apache-2.0 OR GPL-2.0-or-later
+/*
+ * Copyright 2026 IBM Corp.
+ */
+
+#include "pci-stubs.h"
+
+/*
+ * A deep tree of switches: each switch has an upstream port and
+ * SW_PORTS downstream ports, the last level has a multi-function
+ * endpoint below each downstream port.
+ */
+#define SW_PORTS	3
+#define SW_DEPTH	3
+#define EP_FUNCS	8
+#define LOOKUPS		(1 << 20)
+
+static struct phb_ops ops;
+static struct phb phb = { .ops = &ops };
+static unsigned int next_bus;
+static unsigned int nr_devs;
+
+static unsigned long elapsed_ns(struct timespec *start)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_sec - start->tv_sec) * 1000000000ul +
+		end.tv_nsec - start->tv_nsec;
+}
+
+static struct pci_device *add_dev(struct list_head *list, uint16_t bdfn)
+{
+	struct pci_device *pd = zalloc(sizeof(*pd));
+
+	assert(pd);
+	pd->bdfn = bdfn;
+	list_head_init(&pd->children);
+	list_head_init(&pd->pcrf);
+	list_add_tail(list, &pd->link);
+	pci_index_add(&phb, pd);
+	nr_devs++;
+
+	return pd;
+}
+
+static void add_switch(struct list_head *list, unsigned int depth)
+{
+	struct pci_device *usp, *dsp;
+	unsigned int bus = next_bus++;
+	unsigned int sec = next_bus++;
+	unsigned int i, fn, ep;
+
+	usp = add_dev(list, bus << 8);
+	for (i = 0; i < SW_PORTS; i++) {
+		dsp = add_dev(&usp->children, (sec << 8) | (i << 3));
+		if (depth) {
+			add_switch(&dsp->children, depth - 1);
+			continue;
+		}
+		ep = next_bus++;
+		for (fn = 0; fn < EP_FUNCS; fn++)
+			add_dev(&dsp->children, (ep << 8) | fn);
+	}
+}
+
+static int __walk_find_dev(struct phb *phb __unused,
+			   struct pci_device *pd, void *data)
+{
+	return pd->bdfn == *(uint16_t *)data;
+}
+
+/* What pci_find_dev() used to do, for comparison */
+static struct pci_device *walk_find_dev(uint16_t bdfn)
+{
+	return pci_walk_dev(&phb, NULL, __walk_find_dev, &bdfn);
+}
+
+int main(void)
+{
+	struct timespec start;
+	struct pci_device *rp, *pd;
+	unsigned long ns, walk_ns;
+	unsigned int i, bdfn;
+	uint16_t last;
+
+	list_head_init(&phb.devices);
+	assert(!pci_find_dev(&phb, 0));
+
+	rp = add_dev(&phb.devices, next_bus++ << 8);
+	add_switch(&rp->children, SW_DEPTH);
+	assert(next_bus <= 256);
+
+	for (bdfn = 0; bdfn < 0x10000; bdfn++)
+		assert(pci_find_dev(&phb, bdfn) == walk_find_dev(bdfn));
+
+	/* Lookup cost for the last device enumerated, the worst case */
+	last = (next_bus - 1) << 8 | (EP_FUNCS - 1);
+	assert(pci_find_dev(&phb, last));
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < LOOKUPS; i++)
+		assert(pci_find_dev(&phb, last));
+	ns = elapsed_ns(&start);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < LOOKUPS / 256; i++)
+		assert(walk_find_dev(last));
+	walk_ns = elapsed_ns(&start) * 256;
+
+	printf("%u devices on %u buses: %lu ns/lookup (walk: %lu ns/lookup)\n",
+	       nr_devs, next_bus, ns / LOOKUPS, walk_ns / LOOKUPS);
+
+	/* Unplugging a switch takes everything below it out */
+	pd = list_top(&rp->children, struct pci_device, link);
+	pd = list_tail(&pd->children, struct pci_device, link);
+	pci_remove_bus(&phb, &pd->children);
+	assert(!pci_find_dev(&phb, last));
+	assert(pci_find_dev(&phb, pd->bdfn) == pd);
+	for (bdfn = 0; bdfn < 0x10000; bdfn++)
+		assert(pci_find_dev(&phb, bdfn) == walk_find_dev(bdfn));
+
+	/* And a PHB reset empties it */
+	__pci_reset(&phb, &phb.devices);
+	for (bdfn = 0; bdfn < 0x10000; bdfn++)
+		assert(!pci_find_dev(&phb, bdfn));
+
+	for (i = 0; i < ARRAY_SIZE(phb.dev_index); i++)
+		free(phb.dev_index[i]);
+
+	return 0;
+}
@@ -0,0 +1,83 @@
+// SPDX-License-Identifier: Apache-2.0 OR GPL-2.0-or-later
+/*
+ * Copyright 2026 IBM Corp.
+ */
+
+/* Time only moves when someone waits */
+static unsigned long fake_tb;
+
+#define PCI_TEST_TB	fake_tb
+#define PCI_TEST_QUIET
+#include "pci-stubs.h"
+
+static unsigned int nr_waits;
+
+void time_wait(unsigned long duration)
+{
+	fake_tb += duration;
+	nr_waits++;
+}
+
+/*
+ * Each PHB goes through a number of steps, waiting a bit longer at
+ * each, like a slot doing its resets then polling for the link.
+ */
+#define NR_PHBS		48
+#define NR_STEPS	20
+
+static struct phb fake_phbs[NR_PHBS];
+static struct pci_slot fake_slots[NR_PHBS];
+static unsigned int steps[NR_PHBS];
+static unsigned long done_tb[NR_PHBS];
+
+static int64_t fake_run_sm(struct pci_slot *slot)
+{
+	unsigned int i = slot - fake_slots;
+
+	assert(slot->flags & PCI_SLOT_FLAG_BOOTUP);
+	if (steps[i] == NR_STEPS) {
+		done_tb[i] = fake_tb;
+		return i == 7 ? OPAL_HARDWARE : OPAL_SUCCESS;
+	}
+
+	/* Ask for 10ms + a bit, so the PHBs don't stay in lock step */
+	return msecs_to_tb(10) + (++steps[i]) * i;
+}
+
+int main(void)
+{
+	unsigned long serial = 0;
+	unsigned int i;
+
+	for (i = 0; i < NR_PHBS; i++) {
+		fake_slots[i].ops.run_sm = fake_run_sm;
+		fake_slots[i].phb = &fake_phbs[i];
+		fake_phbs[i].slot = &fake_slots[i];
+		phbs[i] = &fake_phbs[i];
+		serial += NR_STEPS * msecs_to_tb(10) +
+			i * NR_STEPS * (NR_STEPS + 1) / 2;
+	}
+	/* One without a state machine is skipped */
+	fake_slots[NR_PHBS - 1].ops.run_sm = NULL;
+	serial -= NR_STEPS * msecs_to_tb(10) +
+		(NR_PHBS - 1) * NR_STEPS * (NR_STEPS + 1) / 2;
+
+	pci_reset_phbs();
+
+	for (i = 0; i < NR_PHBS - 1; i++) {
+		assert(steps[i] == NR_STEPS);
+		assert(!(fake_slots[i].flags & PCI_SLOT_FLAG_BOOTUP));
+		/* Every PHB was stepped as soon as it asked for */
+		assert(done_tb[i] == NR_STEPS * msecs_to_tb(10) +
+		       i * NR_STEPS * (NR_STEPS + 1) / 2);
+	}
+	assert(!steps[NR_PHBS - 1]);
+
+	/* The waits overlapped, we took as long as the slowest PHB */
+	assert(fake_tb == done_tb[NR_PHBS - 2]);
+	printf("%u PHBs reset in %lu ms (%lu ms one after the other), "
+	       "%u waits\n", NR_PHBS - 1, tb_to_msecs(fake_tb),
+	       tb_to_msecs(serial), nr_waits);
+
+	return 0;
+}
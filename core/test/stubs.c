@@ -99,3 +99,26 @@ STUB(dt_has_node_property);
 STUB(dt_get_address);
 STUB(add_chip_dev_associativity);
 STUB(pci_check_clear_freeze);
+STUB(__dt_add_property_cells);
+STUB(__dt_add_property_strings);
+STUB(dt_add_property);
+STUB(dt_add_property_string);
+STUB(dt_find_compatible_node);
+STUB(dt_get_number);
+STUB(dt_new_addr);
+STUB(dt_require_property);
+STUB(find_cpu_by_server);
+STUB(get_chip);
+STUB(check_timers);
+STUB(opal_pending_events);
+STUB(sbe_timer_ok);
+STUB(xive2_get_phandle);
+STUB(dt_free);
+STUB(dt_new);
+STUB(dt_prop_get_def);
+STUB(dt_prop_get_u32_def);
+STUB(dt_prop_get_u32);
+STUB(pci_handle_quirk);
+STUB(pci_slot_add_dt_properties);
+STUB(time_wait);
+STUB(time_wait_ms);
@@ -23,6 +23,7 @@
 #include <libflash/libffs.h>
 #include <libflash/blocklevel.h>
 #include <libflash/ecc.h>
+#include <libflash/file.h>
 #include <common/arch_flash.h>
 
 /*
@@ -455,6 +456,17 @@ int main(int argc, char *argv[])
 		return 3;
 	}
 
+	/*
+	 * Grow the file to its final size up front so the whole image is
+	 * built in a single mapping rather than through read()/write()
+	 */
+	rc = file_set_size(bl, block_size * block_count);
+	if (rc) {
+		fprintf(stderr, "Couldn't size '%s' pnor file\n", pnor);
+		fclose(in_file);
+		return 4;
+	}
+
 	/*
 	 * 'Erase' the file, make it all 0xFF
 	 * TODO: Add sparse option and don't do this.
@@ -24,11 +24,15 @@
 #include <arpa/inet.h>
 #include <assert.h>
 #include <inttypes.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
 
 #include <libflash/libflash.h>
 #include <libflash/libffs.h>
 #include <libflash/blocklevel.h>
 #include <libflash/ecc.h>
+#include <libflash/file.h>
 #include <common/arch_flash.h>
 #include "progress.h"
 
@@ -51,9 +55,234 @@ const char *flashfilename = NULL;
 static bool must_confirm = true;
 static bool dummy_run;
 static bool bmc_flash;
+static bool skip_identical;
+static bool bench;
 
+/*
+ * File I/O is double buffered: a helper thread moves one buffer to or
+ * from the file while the other is being written to or read from
+ * flash. The buffers are suitably aligned for O_DIRECT.
+ */
 #define FILE_BUF_SIZE	0x10000
-static uint8_t file_buf[FILE_BUF_SIZE] __aligned(0x1000);
+#define FILE_BUF_NR	2
+#define FILE_DIO_ALIGN	0x1000
+static uint8_t file_buf[FILE_BUF_NR][FILE_BUF_SIZE] __aligned(FILE_DIO_ALIGN);
+
+struct file_pipe {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	/* Bytes in each buffer, 0 for end of file and -1 for an error */
+	ssize_t len[FILE_BUF_NR];
+	bool full[FILE_BUF_NR];
+	unsigned int head;
+	unsigned int tail;
+	/* Set when either side gives up, the other must stop too */
+	bool abort;
+	int fd;
+	uint32_t size;
+	int err;
+};
+
+static void pipe_init(struct file_pipe *p, int fd, uint32_t size)
+{
+	memset(p, 0, sizeof(*p));
+	pthread_mutex_init(&p->lock, NULL);
+	pthread_cond_init(&p->cond, NULL);
+	p->fd = fd;
+	p->size = size;
+}
+
+static void pipe_destroy(struct file_pipe *p)
+{
+	pthread_cond_destroy(&p->cond);
+	pthread_mutex_destroy(&p->lock);
+}
+
+/* Producer: wait for an empty buffer, NULL if the consumer gave up */
+static uint8_t *pipe_claim(struct file_pipe *p)
+{
+	uint8_t *buf = NULL;
+
+	pthread_mutex_lock(&p->lock);
+	while (p->full[p->head] && !p->abort)
+		pthread_cond_wait(&p->cond, &p->lock);
+	if (!p->abort)
+		buf = file_buf[p->head];
+	pthread_mutex_unlock(&p->lock);
+
+	return buf;
+}
+
+static void pipe_commit(struct file_pipe *p, ssize_t len)
+{
+	pthread_mutex_lock(&p->lock);
+	p->len[p->head] = len;
+	p->full[p->head] = true;
+	p->head = (p->head + 1) % FILE_BUF_NR;
+	pthread_cond_broadcast(&p->cond);
+	pthread_mutex_unlock(&p->lock);
+}
+
+/* Consumer: wait for the next full buffer, -1 if the producer gave up */
+static ssize_t pipe_peek(struct file_pipe *p, uint8_t **buf)
+{
+	ssize_t len;
+
+	pthread_mutex_lock(&p->lock);
+	while (!p->full[p->tail] && !p->abort)
+		pthread_cond_wait(&p->cond, &p->lock);
+	*buf = file_buf[p->tail];
+	len = p->full[p->tail] ? p->len[p->tail] : -1;
+	pthread_mutex_unlock(&p->lock);
+
+	return len;
+}
+
+static void pipe_release(struct file_pipe *p)
+{
+	pthread_mutex_lock(&p->lock);
+	p->full[p->tail] = false;
+	p->tail = (p->tail + 1) % FILE_BUF_NR;
+	pthread_cond_broadcast(&p->cond);
+	pthread_mutex_unlock(&p->lock);
+}
+
+static void pipe_abort(struct file_pipe *p)
+{
+	pthread_mutex_lock(&p->lock);
+	p->abort = true;
+	pthread_cond_broadcast(&p->cond);
+	pthread_mutex_unlock(&p->lock);
+}
+
+/*
+ * O_DIRECT is only a hint here, not every filesystem supports it and
+ * the tail of a file is rarely aligned. Drop it whenever the kernel
+ * complains or the transfer can't satisfy the alignment rules.
+ */
+static int open_direct(const char *file, int flags, mode_t mode)
+{
+	int fd;
+
+	fd = open(file, flags | O_DIRECT, mode);
+	if (fd == -1 && errno == EINVAL)
+		fd = open(file, flags, mode);
+
+	return fd;
+}
+
+static void clear_direct(int fd)
+{
+	int flags = fcntl(fd, F_GETFL);
+
+	if (flags != -1 && (flags & O_DIRECT))
+		fcntl(fd, F_SETFL, flags & ~O_DIRECT);
+}
+
+static ssize_t file_read(int fd, void *buf, size_t len)
+{
+	ssize_t rc;
+
+	rc = read(fd, buf, len);
+	if (rc == -1 && errno == EINVAL) {
+		clear_direct(fd);
+		rc = read(fd, buf, len);
+	}
+
+	return rc;
+}
+
+static ssize_t file_write(int fd, const void *buf, size_t len)
+{
+	ssize_t rc;
+
+	if (len & (FILE_DIO_ALIGN - 1))
+		clear_direct(fd);
+	rc = write(fd, buf, len);
+	if (rc == -1 && errno == EINVAL) {
+		clear_direct(fd);
+		rc = write(fd, buf, len);
+	}
+
+	return rc;
+}
+
+/* Fills buffers from the file for program_file() */
+static void *file_reader(void *arg)
+{
+	struct file_pipe *p = arg;
+	uint32_t remaining = p->size;
+	uint8_t *buf;
+	ssize_t len;
+
+	while (remaining) {
+		buf = pipe_claim(p);
+		if (!buf)
+			break;
+		/* Always ask for a whole buffer to keep O_DIRECT happy */
+		len = file_read(p->fd, buf, FILE_BUF_SIZE);
+		if (len < 0)
+			p->err = errno;
+		pipe_commit(p, len);
+		if (len <= 0)
+			break;
+		remaining -= MIN((uint32_t)len, remaining);
+	}
+
+	return NULL;
+}
+
+/* Drains buffers to the file for do_read_file() */
+static void *file_writer(void *arg)
+{
+	struct file_pipe *p = arg;
+	ssize_t len, rc, done;
+	uint8_t *buf;
+
+	for (;;) {
+		len = pipe_peek(p, &buf);
+		if (len <= 0)
+			break;
+		for (done = 0; done < len; done += rc) {
+			rc = file_write(p->fd, buf + done, len - done);
+			/*
+			 * zero isn't strictly an error.
+			 * Treat it as such so we can be sure we're always
+			 * making forward progress.
+			 */
+			if (rc <= 0) {
+				p->err = rc ? errno : EIO;
+				pipe_abort(p);
+				return NULL;
+			}
+		}
+		pipe_release(p);
+	}
+
+	return NULL;
+}
+
+static void bench_start(struct timespec *ts)
+{
+	if (bench)
+		clock_gettime(CLOCK_MONOTONIC, ts);
+}
+
+static void bench_report(const char *what, uint64_t bytes,
+		const struct timespec *start)
+{
+	struct timespec end;
+	double secs;
+
+	if (!bench)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	secs = (end.tv_sec - start->tv_sec) +
+		(end.tv_nsec - start->tv_nsec) / 1e9;
+	printf("%s: %" PRIu64 " bytes in %.3fs (%.2f MB/s)\n", what, bytes,
+	       secs, secs > 0 ? bytes / secs / (1024 * 1024) : 0.0);
+}
 
 static bool check_confirm(void)
 {
@@ -251,6 +480,7 @@ static struct ffs_handle *lookup_partition_at_side(struct flash_details *flash,
 
 static int erase_chip(struct flash_details *flash)
 {
+	struct timespec ts;
 	bool confirm;
 	int rc;
 	uint64_t pos;
@@ -273,6 +503,7 @@ static int erase_chip(struct flash_details *flash)
 	 * likes the progress bars.
 	 * Lets do an erase block at a time erase then...
 	 */
+	bench_start(&ts);
 	progress_init(flash->total_size);
 	for (pos = 0; pos < flash->total_size; pos += flash->erase_granule) {
 		rc = blocklevel_erase(flash->bl, pos, flash->erase_granule);
@@ -285,6 +516,7 @@ static int erase_chip(struct flash_details *flash)
 		fprintf(stderr, "Error %d erasing chip\n", rc);
 		return rc;
 	}
+	bench_report("Erase", flash->total_size, &ts);
 
 	printf("done !\n");
 	return 0;
@@ -296,6 +528,7 @@ static int erase_range(struct flash_details *flash,
 {
 	uint32_t done = 0, erase_mask = flash->erase_granule - 1;
 	struct ffs_entry *toc;
+	struct timespec ts;
 	bool confirm;
 	int rc;
 
@@ -314,6 +547,7 @@ static int erase_range(struct flash_details *flash,
 	 * blocklevel_smart_erase() can do the entire thing in one call
 	 * BUT everyone really likes progress bars so break stuff up
 	 */
+	bench_start(&ts);
 	progress_init(size);
 	if (start & erase_mask) {
 		/*
@@ -353,6 +587,7 @@ static int erase_range(struct flash_details *flash,
 		progress_tick(done);
 	}
 	progress_end();
+	bench_report("Erase", done, &ts);
 
 	if (!ffsh)
 		return 0;
@@ -415,10 +650,13 @@ static int program_file(struct blocklevel_device *bl,
 {
 	uint32_t actual_size = 0;
 	struct ffs_entry *toc;
+	struct file_pipe pipe;
+	pthread_t reader;
+	struct timespec ts;
 	int fd, rc = 0;
 	bool confirm;
 
-	fd = open(file, O_RDONLY);
+	fd = open_direct(file, O_RDONLY, 0);
 	if (fd == -1) {
 		perror("Failed to open file");
 		return 1;
@@ -437,16 +675,27 @@ static int program_file(struct blocklevel_device *bl,
 		goto out;
 	}
 
+	pipe_init(&pipe, fd, size);
+	if (pthread_create(&reader, NULL, file_reader, &pipe)) {
+		fprintf(stderr, "Failed to start file reader\n");
+		pipe_destroy(&pipe);
+		rc = 1;
+		goto out;
+	}
+
 	printf("Programming & Verifying...\n");
+	bench_start(&ts);
 	progress_init(size);
 	while(size) {
+		uint8_t *buf;
 		ssize_t len;
 
-		len = read(fd, file_buf, FILE_BUF_SIZE);
+		len = pipe_peek(&pipe, &buf);
 		if (len < 0) {
+			errno = pipe.err;
 			perror("Error reading file");
 			rc = 1;
-			goto out;
+			break;
 		}
 		if (len == 0)
 			break;
@@ -454,7 +703,16 @@ static int program_file(struct blocklevel_device *bl,
 			len = size;
 		size -= len;
 		actual_size += len;
-		rc = blocklevel_write(bl, start, file_buf, len);
+		/*
+		 * blocklevel_smart_write() compares each erase block with
+		 * what is already there and only erases and programs the
+		 * ones which differ.
+		 */
+		if (skip_identical)
+			rc = blocklevel_smart_write(bl, start, buf, len);
+		else
+			rc = blocklevel_write(bl, start, buf, len);
+		pipe_release(&pipe);
 		if (rc) {
 			if (rc == FLASH_ERR_VERIFY_FAILURE)
 				fprintf(stderr, "Verification failed for"
@@ -462,12 +720,18 @@ static int program_file(struct blocklevel_device *bl,
 			else
 				fprintf(stderr, "Flash write error %d for"
 					" chunk at 0x%08x\n", rc, start);
-			goto out;
+			break;
 		}
 		start += len;
 		progress_tick(actual_size);
 	}
+	pipe_abort(&pipe);
+	pthread_join(reader, NULL);
+	pipe_destroy(&pipe);
+	if (rc)
+		goto out;
 	progress_end();
+	bench_report("Program", actual_size, &ts);
 
 	if (!ffsh)
 		goto out;
@@ -493,10 +757,13 @@ out:
 static int do_read_file(struct blocklevel_device *bl, const char *file,
 		uint32_t start, uint32_t size, uint32_t skip_size)
 {
-	int fd, rc = 0;
+	struct file_pipe pipe;
+	pthread_t writer;
+	struct timespec ts;
 	uint32_t done = 0;
+	int fd, rc = 0;
 
-	fd = open(file, O_WRONLY | O_TRUNC | O_CREAT, 00666);
+	fd = open_direct(file, O_WRONLY | O_TRUNC | O_CREAT, 00666);
 	if (fd == -1) {
 		perror("Failed to open file");
 		return 1;
@@ -507,35 +774,57 @@ static int do_read_file(struct blocklevel_device *bl, const char *file,
 	printf("Reading to \"%s\" from 0x%08x..0x%08x !\n",
 	       file, start, start + size);
 
+	pipe_init(&pipe, fd, size);
+	if (pthread_create(&writer, NULL, file_writer, &pipe)) {
+		fprintf(stderr, "Failed to start file writer\n");
+		pipe_destroy(&pipe);
+		close(fd);
+		return 1;
+	}
+
+	bench_start(&ts);
 	progress_init(size);
 	while(size) {
+		uint8_t *buf;
 		ssize_t len;
 
+		buf = pipe_claim(&pipe);
+		if (!buf) {
+			errno = pipe.err;
+			perror("Error writing file");
+			rc = 1;
+			break;
+		}
 		len = size > FILE_BUF_SIZE ? FILE_BUF_SIZE : size;
-		rc = blocklevel_read(bl, start, file_buf, len);
+		rc = blocklevel_read(bl, start, buf, len);
 		if (rc) {
 			fprintf(stderr, "Flash read error %d for"
 				" chunk at 0x%08x\n", rc, start);
 			break;
 		}
-		rc = write(fd, file_buf, len);
-		/*
-		 * zero isn't strictly an error.
-		 * Treat it as such so we can be sure we'lre always
-		 * making forward progress.
-		 */
-		if (rc <= 0) {
-			perror("Error writing file");
-			break;
-		}
-		start += rc;
-		size -= rc;
-		done += rc;
+		pipe_commit(&pipe, len);
+		start += len;
+		size -= len;
+		done += len;
 		progress_tick(done);
 	}
+	/* An empty buffer tells the writer we are done */
+	if (!size && pipe_claim(&pipe))
+		pipe_commit(&pipe, 0);
+	else
+		pipe_abort(&pipe);
+	pthread_join(writer, NULL);
+	if (!size && pipe.err) {
+		errno = pipe.err;
+		perror("Error writing file");
+		rc = 1;
+	}
+	pipe_destroy(&pipe);
 	progress_end();
+	if (!rc)
+		bench_report("Read", done, &ts);
 	close(fd);
-	return size ? rc : 0;
+	return rc;
 }
 
 static int enable_4B_addresses(struct blocklevel_device *bl)
@@ -672,6 +961,13 @@ static void print_help(const char *pname)
 	printf("\t-T, --toc\n");
 	printf("\t\tlibffs TOC on which to operate, defaults to 0.\n");
 	printf("\t\tleading 0x is required for interpretation of a hex value\n\n");
+	printf("\t--skip-identical\n");
+	printf("\t\tWhen programming, compare each erase block with the\n");
+	printf("\t\tfile first and only erase and program the blocks which\n");
+	printf("\t\tdiffer. No separate erase command is needed\n\n");
+	printf("\t--bench\n");
+	printf("\t\tReport the time taken and throughput in MB/s of\n");
+	printf("\t\tthe read, erase and program operations\n\n");
 	printf("\t-g\n");
 	printf("\t\tEnable verbose libflash debugging\n\n");
 	printf(" Commands:\n");
@@ -769,6 +1065,8 @@ int main(int argc, char *argv[])
 			{"toc",		required_argument,	NULL,	'T'},
 			{"clear",   no_argument,        NULL,   'c'},
 			{"ecc",         no_argument,            NULL,   '9'},
+			{"skip-identical", no_argument,		NULL,	'I'},
+			{"bench",	no_argument,		NULL,	'B'},
 			{NULL,	    0,                  NULL,    0 }
 		};
 		int c, oidx = 0;
@@ -891,6 +1189,12 @@ int main(int argc, char *argv[])
 		case '9':
 			flash.mark_ecc = true;
 			break;
+		case 'I':
+			skip_identical = true;
+			break;
+		case 'B':
+			bench = true;
+			break;
 		case ':':
 			fprintf(stderr, "Unrecognised option \"%s\" to '%c'\n", optarg, optopt);
 			no_action = true;
@@ -984,6 +1288,13 @@ int main(int argc, char *argv[])
 		goto out;
 	}
 
+	/* Skip identical only makes sense when programming */
+	if (skip_identical && !program) {
+		fprintf(stderr, "--skip-identical requires a --program command !\n");
+		rc = 1;
+		goto out;
+	}
+
 	/* Program command should always come with a file */
 	if (program && !write_file) {
 		fprintf(stderr, "Program with no file specified !\n");
@@ -1201,6 +1512,22 @@ int main(int argc, char *argv[])
 			goto close;
 		}
 	}
+
+	/*
+	 * Allocate all of an image file's blocks so that erasing and
+	 * programming it goes through a single mapping rather than a
+	 * write() per erase granule.
+	 */
+	if ((erase || program || do_clear) && flashfilename && !dummy_run) {
+		rc = file_set_size(flash.bl, 0);
+		if (rc) {
+			fprintf(stderr, "Couldn't allocate '%s': %d\n",
+				flashfilename, rc);
+			rc = 1;
+			goto close;
+		}
+	}
+
 	rc = 0;
 	if (do_read)
 		rc = do_read_file(flash.bl, read_file, address, read_size, skip_size);
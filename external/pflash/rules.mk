@@ -53,5 +53,5 @@ $(CCAN_OBJS): ccan-list-%.o: ccan/list/%.c | links
 	$(Q_CC)$(CC) $(CFLAGS) -c $< -o $@
 
 $(EXE): $(OBJS)
-	$(Q_CC)$(CC) $(LDFLAGS) $(CFLAGS) $^ -lrt -o $@
+	$(Q_CC)$(CC) $(LDFLAGS) $(CFLAGS) $^ -lrt -lpthread -o $@
 
@@ -0,0 +1 @@
+const char version[] = "4012a72";
@@ -16,11 +16,13 @@
 
 static void print_usage(int code)
 {
-	printf("usage: getscom [-c|--chip chip-id] [-b|--list-bits] addr\n");
+	printf("usage: getscom [-c|--chip chip-id] [-b|--list-bits] addr [addr...]\n");
 	printf("       getscom -l|--list-chips\n");
 	printf("       getscom -v|--version\n");
 	printf("\n");
 	printf("       NB: --list-bits shows which PPC bits are set\n");
+	printf("       NB: with several addresses each value is prefixed\n");
+	printf("           by its address\n");
 	exit(code);
 }
 
@@ -72,12 +74,31 @@ static void print_chip_info(uint32_t chip_id)
 	       chip_id, (cfam_id >> 16) & 0xf, (cfam_id >> 8) & 0xf, name);
 }
 
+static void print_value(uint64_t val, bool list_bits)
+{
+	printf("%016" PRIx64, val);
+
+	if (list_bits) {
+		int i;
+
+		printf(" - set: ");
+
+		for (i = 0; i < 64; i++)
+			if (val & PPC_BIT(i))
+				printf("%d ", i);
+	}
+
+	putchar('\n');
+}
+
 extern const char version[];
 
 int main(int argc, char *argv[])
 {
-	uint64_t val, addr = -1ull;
+	uint64_t val, *addrs = NULL;
 	uint32_t def_chip, chip_id = 0xffffffff;
+	unsigned int i, n_addrs = 0;
+	struct xscom_op *ops;
 	bool list_chips = false;
 	bool no_work = false;
 	bool list_bits = false;
@@ -98,7 +119,12 @@ int main(int argc, char *argv[])
 			break;
 		switch(c) {
 		case 1:
-			addr = strtoull(optarg, NULL, 16);
+			addrs = realloc(addrs, (n_addrs + 1) * sizeof(*addrs));
+			if (!addrs) {
+				perror("Failed to allocate addresses");
+				exit(1);
+			}
+			addrs[n_addrs++] = strtoull(optarg, NULL, 16);
 			break;
 		case 'c':
 			chip_id = strtoul(optarg, NULL, 16);
@@ -120,7 +146,7 @@ int main(int argc, char *argv[])
 		}
 	}
 	
-	if (addr == -1ull)
+	if (!n_addrs)
 		no_work = true;
 	if (no_work && !list_chips) {
 		fprintf(stderr, "Invalid or missing address\n");
@@ -142,26 +168,37 @@ int main(int argc, char *argv[])
 	if (chip_id == 0xffffffff)
 		chip_id = def_chip;
 
-	rc = xscom_read(chip_id, addr, &val);
-	if (rc) {
-		fprintf(stderr,"Error %d reading XSCOM\n", rc);
-		exit(1);
-	}
+	if (n_addrs == 1) {
+		rc = xscom_read(chip_id, addrs[0], &val);
+		if (rc) {
+			fprintf(stderr,"Error %d reading XSCOM\n", rc);
+			exit(1);
+		}
 
-	printf("%016" PRIx64, val);
+		print_value(val, list_bits);
+		return 0;
+	}
 
-	if (list_bits) {
-		int i;
+	ops = calloc(n_addrs, sizeof(*ops));
+	if (!ops) {
+		perror("Failed to allocate XSCOM batch");
+		exit(1);
+	}
+	for (i = 0; i < n_addrs; i++) {
+		ops[i].chip_id = chip_id;
+		ops[i].op = XSCOM_OP_READ;
+		ops[i].addr = addrs[i];
+	}
 
-		printf(" - set: ");
+	rc = xscom_batch(ops, n_addrs);
 
-		for (i = 0; i < 64; i++)
-			if (val & PPC_BIT(i))
-				printf("%d ", i);
+	for (i = 0; i < n_addrs; i++) {
+		printf("%016" PRIx64 ": ", ops[i].addr);
+		if (ops[i].rc)
+			printf("error %d\n", ops[i].rc);
+		else
+			print_value(ops[i].value, list_bits);
 	}
 
-	putchar('\n');
-
-	return 0;
+	return rc ? 1 : 0;
 }
-
@@ -170,6 +170,100 @@ int xscom_write(uint32_t chip_id, uint64_t addr, uint64_t val)
 	return 0;
 }
 
+/*
+ * The debugfs interface reads consecutive registers for a single read()
+ * of more than 8 bytes, so runs of reads of consecutive direct
+ * addresses on the same chip only cost one syscall (and the kernel one
+ * OPAL call per register). A short read means the register after the
+ * last one returned failed, that one is retried on its own to get its
+ * error code and the rest of the run is batched again.
+ */
+#define XSCOM_BATCH_RUN		64
+
+static unsigned int xscom_batch_run(struct xscom_op *ops, unsigned int count)
+{
+	unsigned int n;
+
+	if (ops[0].op != XSCOM_OP_READ || (ops[0].addr >> 60))
+		return 1;
+
+	for (n = 1; n < count && n < XSCOM_BATCH_RUN; n++) {
+		if (ops[n].op != XSCOM_OP_READ ||
+		    ops[n].chip_id != ops[0].chip_id ||
+		    ops[n].addr != ops[0].addr + n)
+			break;
+	}
+
+	return n;
+}
+
+static unsigned int xscom_batch_read_run(struct xscom_op *ops,
+					 unsigned int count)
+{
+	struct xscom_chip *c = xscom_find_chip(ops[0].chip_id);
+	uint64_t vals[XSCOM_BATCH_RUN];
+	unsigned int i, done;
+	ssize_t rc;
+
+	if (!c || count == 1)
+		return 0;
+
+	rc = pread64(c->fd, vals, count * 8, xscom_mangle_addr(ops[0].addr));
+	if (rc < 0)
+		return 0;
+
+	done = rc / 8;
+	for (i = 0; i < done; i++) {
+		ops[i].value = vals[i];
+		ops[i].rc = 0;
+	}
+
+	return done;
+}
+
+static int xscom_batch_one(struct xscom_op *op)
+{
+	uint64_t old_val;
+	int rc;
+
+	switch (op->op) {
+	case XSCOM_OP_READ:
+		return xscom_read(op->chip_id, op->addr, &op->value);
+	case XSCOM_OP_WRITE:
+		return xscom_write(op->chip_id, op->addr, op->value);
+	case XSCOM_OP_WRITE_MASK:
+		rc = xscom_read(op->chip_id, op->addr, &old_val);
+		if (rc)
+			return rc;
+		return xscom_write(op->chip_id, op->addr,
+				   (old_val & ~op->mask) |
+				   (op->value & op->mask));
+	}
+
+	return -EINVAL;
+}
+
+int xscom_batch(struct xscom_op *ops, unsigned int count)
+{
+	unsigned int i = 0, run, done;
+	int failed = 0;
+
+	while (i < count) {
+		run = xscom_batch_run(&ops[i], count - i);
+		done = xscom_batch_read_run(&ops[i], run);
+		i += done;
+		if (done == run)
+			continue;
+
+		ops[i].rc = xscom_batch_one(&ops[i]);
+		if (ops[i].rc)
+			failed++;
+		i++;
+	}
+
+	return failed;
+}
+
 int xscom_read_ex(uint32_t ex_target_id, uint64_t addr, uint64_t *val)
 {
 	uint32_t chip_id = ex_target_id >> 4;;
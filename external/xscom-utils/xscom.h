@@ -13,6 +13,25 @@ extern int xscom_write(uint32_t chip_id, uint64_t addr, uint64_t val);
 extern int xscom_read_ex(uint32_t ex_target_id, uint64_t addr, uint64_t *val);
 extern int xscom_write_ex(uint32_t ex_target_id, uint64_t addr, uint64_t val);
 
+/*
+ * Batched access, mirrors the descriptors of OPAL_XSCOM_BATCH. Every
+ * entry is attempted and gets its own rc, xscom_batch() returns the
+ * number of failed entries.
+ */
+struct xscom_op {
+	uint32_t	chip_id;
+	uint32_t	op;
+#define XSCOM_OP_READ		0
+#define XSCOM_OP_WRITE		1
+#define XSCOM_OP_WRITE_MASK	2
+	uint64_t	addr;
+	uint64_t	value;
+	uint64_t	mask;
+	int		rc;
+};
+
+extern int xscom_batch(struct xscom_op *ops, unsigned int count);
+
 extern void xscom_for_each_chip(void (*cb)(uint32_t chip_id));
 
 extern bool xscom_readable(uint64_t addr);
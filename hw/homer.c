@@ -50,13 +50,13 @@ static bool read_pba_bar(struct proc_chip *chip, unsigned int bar_no,
 	uint64_t bar, mask;
 	int rc;
 
-	rc = xscom_read(chip->id, pba_bar0 + bar_no, &bar);
+	rc = xscom_read_cached(chip->id, pba_bar0 + bar_no, &bar);
 	if (rc) {
 		prerror("SLW: Error %d reading PBA BAR%d on chip %d\n",
 			rc, bar_no, chip->id);
 		return false;
 	}
-	rc = xscom_read(chip->id, pba_barmask0 + bar_no, &mask);
+	rc = xscom_read_cached(chip->id, pba_barmask0 + bar_no, &mask);
 	if (rc) {
 		prerror("SLW: Error %d reading PBA BAR MASK%d on chip %d\n",
 			rc, bar_no, chip->id);
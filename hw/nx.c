@@ -41,7 +41,7 @@ static void darn_init(void)
 
 	for_each_chip(chip) {
 		/* is this NX enabled? */
-		xscom_read(chip->id, P9X_NX_MMIO_BAR, &bar);
+		xscom_read_cached(chip->id, P9X_NX_MMIO_BAR, &bar);
 		if (!(bar & ~P9X_NX_MMIO_BAR_EN))
 			bar = default_bar;
 
@@ -281,6 +281,13 @@ static inline void phb4_ioda_sel(struct phb4 *p, uint32_t table,
 		       (autoinc ? PHB_IODA_AD_AUTOINC : 0)	|
 		       SETFIELD(PHB_IODA_AD_TSEL, 0ul, table)	|
 		       SETFIELD(PHB_IODA_AD_TADR, 0ul, addr));
+	p->ioda_mmios++;
+}
+
+static inline void phb4_ioda_write(struct phb4 *p, uint64_t val)
+{
+	out_be64(p->regs + PHB_IODA_DATA0, val);
+	p->ioda_mmios++;
 }
 
 /*
@@ -1043,6 +1050,64 @@ static int64_t phb4_wait_bit(struct phb4 *p, uint32_t reg,
 	return OPAL_SUCCESS;
 }
 
+static int64_t phb4_tce_kill_pages(struct phb4 *p, uint64_t pe_number,
+				   uint32_t tce_size, uint64_t dma_addr,
+				   uint32_t npages)
+{
+	uint64_t val, psel;
+	int64_t rc;
+
+	/* Set appropriate page size, the alignment holds for all pages */
+	switch(tce_size) {
+	case 0x1000:
+		if (dma_addr & 0xf000000000000fffull)
+			return OPAL_PARAMETER;
+		psel = 0;
+		break;
+	case 0x10000:
+		if (dma_addr & 0xf00000000000ffffull)
+			return OPAL_PARAMETER;
+		psel = PHB_TCE_KILL_PSEL | PHB_TCE_KILL_64K;
+		break;
+	case 0x200000:
+		if (dma_addr & 0xf0000000001fffffull)
+			return OPAL_PARAMETER;
+		psel = PHB_TCE_KILL_PSEL | PHB_TCE_KILL_2M;
+		break;
+	case 0x40000000:
+		if (dma_addr & 0xf00000003fffffffull)
+			return OPAL_PARAMETER;
+		psel = PHB_TCE_KILL_PSEL | PHB_TCE_KILL_1G;
+		break;
+	default:
+		return OPAL_PARAMETER;
+	}
+
+	/*
+	 * Queue the kills back to back, we only stall when the HW kill
+	 * queue is full. Completion of the whole lot is waited for once
+	 * by the caller.
+	 */
+	while (npages--) {
+		/* Wait for a slot in the HW kill queue */
+		rc = phb4_wait_bit(p, PHB_TCE_KILL,
+				   PHB_TCE_KILL_ALL |
+				   PHB_TCE_KILL_PE |
+				   PHB_TCE_KILL_ONE, 0);
+		if (rc)
+			return rc;
+		val = SETFIELD(PHB_TCE_KILL_PENUM, dma_addr, pe_number);
+
+		/* Perform kill */
+		out_be64(p->regs + PHB_TCE_KILL, PHB_TCE_KILL_ONE | psel | val);
+		p->tce_kill_pages++;
+		/* Next page */
+		dma_addr += tce_size;
+	}
+
+	return OPAL_SUCCESS;
+}
+
 static int64_t phb4_tce_kill(struct phb *phb, uint32_t kill_type,
 			     uint64_t pe_number, uint32_t tce_size,
 			     uint64_t dma_addr, uint32_t npages)
@@ -1054,53 +1119,22 @@ static int64_t phb4_tce_kill(struct phb *phb, uint32_t kill_type,
 	/*
 	 * HW560152: a page-level kill can be dropped if the
 	 *	 processing queue is backed-up, which can cause data
-	 *	 integrity issues
+	 *	 integrity issues. Fixed on PHB5.
+	 *
+	 * Large ranges are cheaper to kill as a whole PE anyway.
 	 */
-	if (kill_type == OPAL_PCI_TCE_KILL_PAGES)
+	if (kill_type == OPAL_PCI_TCE_KILL_PAGES &&
+	    (!(p->flags & PHB4_TCE_KILL_RANGE) ||
+	     npages > PHB4_TCE_KILL_PAGES_MAX))
 		kill_type = OPAL_PCI_TCE_KILL_PE;
 
 	sync();
 	switch(kill_type) {
 	case OPAL_PCI_TCE_KILL_PAGES:
-		while (npages--) {
-			/* Wait for a slot in the HW kill queue */
-			rc = phb4_wait_bit(p, PHB_TCE_KILL,
-					   PHB_TCE_KILL_ALL |
-					   PHB_TCE_KILL_PE |
-					   PHB_TCE_KILL_ONE, 0);
-			if (rc)
-				return rc;
-			val = SETFIELD(PHB_TCE_KILL_PENUM, dma_addr, pe_number);
-
-			/* Set appropriate page size */
-			switch(tce_size) {
-			case 0x1000:
-				if (dma_addr & 0xf000000000000fffull)
-					return OPAL_PARAMETER;
-				break;
-			case 0x10000:
-				if (dma_addr & 0xf00000000000ffffull)
-					return OPAL_PARAMETER;
-				val |= PHB_TCE_KILL_PSEL | PHB_TCE_KILL_64K;
-				break;
-			case 0x200000:
-				if (dma_addr & 0xf0000000001fffffull)
-					return OPAL_PARAMETER;
-				val |= PHB_TCE_KILL_PSEL | PHB_TCE_KILL_2M;
-				break;
-			case 0x40000000:
-				if (dma_addr & 0xf00000003fffffffull)
-					return OPAL_PARAMETER;
-				val |= PHB_TCE_KILL_PSEL | PHB_TCE_KILL_1G;
-				break;
-			default:
-				return OPAL_PARAMETER;
-			}
-			/* Perform kill */
-			out_be64(p->regs + PHB_TCE_KILL, PHB_TCE_KILL_ONE | val);
-			/* Next page */
-			dma_addr += tce_size;
-		}
+		rc = phb4_tce_kill_pages(p, pe_number, tce_size, dma_addr,
+					 npages);
+		if (rc)
+			return rc;
 		break;
 	case OPAL_PCI_TCE_KILL_PE:
 		/* Wait for a slot in the HW kill queue */
@@ -1128,6 +1162,7 @@ static int64_t phb4_tce_kill(struct phb *phb, uint32_t kill_type,
 	default:
 		return OPAL_PARAMETER;
 	}
+	p->tce_kills[kill_type]++;
 
 	/* Start DMA sync process */
 	if (is_phb5()){
@@ -1166,6 +1201,7 @@ static int64_t phb4_tce_kill(struct phb *phb, uint32_t kill_type,
 static int64_t phb4_ioda_reset(struct phb *phb, bool purge)
 {
 	struct phb4 *p = phb_to_phb4(phb);
+	uint64_t mmios = p->ioda_mmios;
 	uint32_t i;
 	uint64_t val;
 
@@ -1178,51 +1214,59 @@ static int64_t phb4_ioda_reset(struct phb *phb, bool purge)
 
 	/* Init_30..31 - Errata workaround, clear PESTA entry 0 */
 	phb4_ioda_sel(p, IODA3_TBL_PESTA, 0, false);
-	out_be64(p->regs + PHB_IODA_DATA0, 0);
+	phb4_ioda_write(p, 0);
 
 	/* Init_32..33 - MIST  */
 	phb4_ioda_sel(p, IODA3_TBL_MIST, 0, true);
 	val = in_be64(p->regs + PHB_IODA_ADDR);
 	val = SETFIELD(PHB_IODA_AD_MIST_PWV, val, 0xf);
 	out_be64(p->regs + PHB_IODA_ADDR, val);
+	p->ioda_mmios += 2;
 	for (i = 0; i < (p->num_irqs/4); i++)
-		out_be64(p->regs + PHB_IODA_DATA0, p->mist_cache[i]);
+		phb4_ioda_write(p, p->mist_cache[i]);
 
 	/* Init_34..35 - MRT */
 	phb4_ioda_sel(p, IODA3_TBL_MRT, 0, true);
 	for (i = 0; i < p->mrt_size; i++)
-		out_be64(p->regs + PHB_IODA_DATA0, 0);
+		phb4_ioda_write(p, 0);
 
 	/* Init_36..37 - TVT */
 	phb4_ioda_sel(p, IODA3_TBL_TVT, 0, true);
 	for (i = 0; i < p->tvt_size; i++)
-		out_be64(p->regs + PHB_IODA_DATA0, p->tve_cache[i]);
+		phb4_ioda_write(p, p->tve_cache[i]);
 
 	/* Init_38..39 - MBT */
 	phb4_ioda_sel(p, IODA3_TBL_MBT, 0, true);
 	for (i = 0; i < p->mbt_size; i++) {
-		out_be64(p->regs + PHB_IODA_DATA0, p->mbt_cache[i][0]);
-		out_be64(p->regs + PHB_IODA_DATA0, p->mbt_cache[i][1]);
+		phb4_ioda_write(p, p->mbt_cache[i][0]);
+		phb4_ioda_write(p, p->mbt_cache[i][1]);
 	}
 
 	/* Init_40..41 - MDT */
 	phb4_ioda_sel(p, IODA3_TBL_MDT, 0, true);
 	for (i = 0; i < p->max_num_pes; i++)
-		out_be64(p->regs + PHB_IODA_DATA0, p->mdt_cache[i]);
+		phb4_ioda_write(p, p->mdt_cache[i]);
 
 	/* Additional OPAL specific inits */
 
 	/* Clear PEST & PEEV */
-	for (i = 0; i < p->max_num_pes; i++) {
-		phb4_ioda_sel(p, IODA3_TBL_PESTA, i, false);
-		out_be64(p->regs + PHB_IODA_DATA0, 0);
-		phb4_ioda_sel(p, IODA3_TBL_PESTB, i, false);
-		out_be64(p->regs + PHB_IODA_DATA0, 0);
-	}
+	phb4_ioda_sel(p, IODA3_TBL_PESTA, 0, true);
+	for (i = 0; i < p->max_num_pes; i++)
+		phb4_ioda_write(p, 0);
+	phb4_ioda_sel(p, IODA3_TBL_PESTB, 0, true);
+	for (i = 0; i < p->max_num_pes; i++)
+		phb4_ioda_write(p, 0);
 
 	phb4_ioda_sel(p, IODA3_TBL_PEEV, 0, true);
 	for (i = 0; i < p->max_num_pes/64; i++)
-		out_be64(p->regs + PHB_IODA_DATA0, 0);
+		phb4_ioda_write(p, 0);
+
+	/* Every shadow entry was just written, nothing left to flush */
+	memset(p->mist_dirty, 0, sizeof(p->mist_dirty));
+	memset(p->tve_dirty, 0, sizeof(p->tve_dirty));
+
+	PHBDBG(p, "IODA reset took %llu IODA accesses\n",
+	       p->ioda_mmios - mmios);
 
 	/* Invalidate RTE, TCE cache */
 	out_be64(p->regs + PHB_RTC_INVALIDATE, PHB_RTC_INVALIDATE_ALL);
@@ -1479,6 +1523,17 @@ static int64_t phb4_map_pe_mmio_window(struct phb *phb,
 	return OPAL_SUCCESS;
 }
 
+static void phb4_set_tve(struct phb4 *p, uint32_t window_id, uint64_t tve)
+{
+	p->tve_cache[window_id] = tve;
+	if (p->pe_batch) {
+		bitmap_set_bit(p->tve_dirty, window_id);
+		return;
+	}
+	phb4_ioda_sel(p, IODA3_TBL_TVT, window_id, false);
+	phb4_ioda_write(p, tve);
+}
+
 static int64_t phb4_map_pe_dma_window(struct phb *phb,
 				      uint64_t pe_number,
 				      uint16_t window_id,
@@ -1511,9 +1566,7 @@ static int64_t phb4_map_pe_dma_window(struct phb *phb,
 	 * we ignore other arguments
 	 */
 	if (tce_table_size == 0) {
-		phb4_ioda_sel(p, IODA3_TBL_TVT, window_id, false);
-		out_be64(p->regs + PHB_IODA_DATA0, 0);
-		p->tve_cache[window_id] = 0;
+		phb4_set_tve(p, window_id, 0);
 		return OPAL_SUCCESS;
 	}
 
@@ -1551,9 +1604,7 @@ static int64_t phb4_map_pe_dma_window(struct phb *phb,
 	/* Encode number of levels */
 	data64 = SETFIELD(IODA3_TVT_NUM_LEVELS, data64, tce_levels - 1);
 
-	phb4_ioda_sel(p, IODA3_TBL_TVT, window_id, false);
-	out_be64(p->regs + PHB_IODA_DATA0, data64);
-	p->tve_cache[window_id] = data64;
+	phb4_set_tve(p, window_id, data64);
 
 	return OPAL_SUCCESS;
 }
@@ -1614,9 +1665,7 @@ static int64_t phb4_map_pe_dma_window_real(struct phb *phb,
 		tve = 0;
 	}
 
-	phb4_ioda_sel(p, IODA3_TBL_TVT, window_id, false);
-	out_be64(p->regs + PHB_IODA_DATA0, tve);
-	p->tve_cache[window_id] = tve;
+	phb4_set_tve(p, window_id, tve);
 
 	return OPAL_SUCCESS;
 }
@@ -1697,6 +1746,12 @@ static int64_t phb4_set_ive_pe(struct phb *phb,
 	p->mist_cache[mist_idx] &= ~(0x0fffull << mist_shift);
 	p->mist_cache[mist_idx] |=  ((uint64_t)pe_number) << mist_shift;
 
+	/* Batched, phb4_pe_batch_end() writes each entry once */
+	if (p->pe_batch) {
+		p->mist_dirty[mist_idx] |= 8 >> mist_quad;
+		return OPAL_SUCCESS;
+	}
+
 	/* Note: This has the side effect of clearing P/Q, so this
 	 * shouldn't be called while the interrupt is "hot"
 	 */
@@ -2279,11 +2334,81 @@ static int64_t phb4_set_pe(struct phb *phb,
 			p->tbl_rtt[idx] = cpu_to_be16(pe_number);
 
 	/* Invalidate the RID Translation Cache (RTC) inside the PHB */
-	out_be64(p->regs + PHB_RTC_INVALIDATE, PHB_RTC_INVALIDATE_ALL);
+	if (p->pe_batch)
+		p->rtc_dirty = true;
+	else
+		out_be64(p->regs + PHB_RTC_INVALIDATE, PHB_RTC_INVALIDATE_ALL);
 
 	return OPAL_SUCCESS;
 }
 
+static void phb4_pe_batch_start(struct phb *phb)
+{
+	struct phb4 *p = phb_to_phb4(phb);
+
+	p->pe_batch = true;
+}
+
+/*
+ * Write back the dirty entries of the shadow IODA tables. Runs of
+ * consecutive entries are written with a single auto-increment
+ * select.
+ */
+static void phb4_ioda_flush(struct phb4 *p)
+{
+	uint32_t tvt_size = p->tvt_size;
+	uint32_t i, mist_size = p->num_irqs / 4;
+	uint8_t pwv;
+	int s, e;
+
+	for (s = bitmap_find_one_bit(p->tve_dirty, 0, tvt_size); s >= 0;
+	     s = bitmap_find_one_bit(p->tve_dirty, e, tvt_size - e)) {
+		e = bitmap_find_zero_bit(p->tve_dirty, s, tvt_size - s);
+		if (e < 0)
+			e = tvt_size;
+		phb4_ioda_sel(p, IODA3_TBL_TVT, s, true);
+		for (i = s; i < e; i++) {
+			phb4_ioda_write(p, p->tve_cache[i]);
+			bitmap_clr_bit(p->tve_dirty, i);
+		}
+	}
+
+	/*
+	 * For the MIST, only the quads that changed are written to keep
+	 * the P/Q of the others, so a run also needs the same quads.
+	 */
+	for (i = 0; i < mist_size;) {
+		pwv = p->mist_dirty[i];
+		if (!pwv) {
+			i++;
+			continue;
+		}
+		phb4_write_reg(p, PHB_IODA_ADDR, PHB_IODA_AD_AUTOINC |
+			       SETFIELD(PHB_IODA_AD_TSEL, 0ul, IODA3_TBL_MIST) |
+			       SETFIELD(PHB_IODA_AD_TADR, 0ul, i) |
+			       SETFIELD(PHB_IODA_AD_MIST_PWV, 0ul, pwv));
+		p->ioda_mmios++;
+		for (; i < mist_size && p->mist_dirty[i] == pwv; i++) {
+			phb4_ioda_write(p, p->mist_cache[i]);
+			p->mist_dirty[i] = 0;
+		}
+	}
+}
+
+static void phb4_pe_batch_end(struct phb *phb)
+{
+	struct phb4 *p = phb_to_phb4(phb);
+
+	p->pe_batch = false;
+
+	if (p->rtc_dirty) {
+		out_be64(p->regs + PHB_RTC_INVALIDATE, PHB_RTC_INVALIDATE_ALL);
+		p->rtc_dirty = false;
+	}
+
+	phb4_ioda_flush(p);
+}
+
 static int64_t phb4_set_peltv(struct phb *phb,
 			      uint32_t parent_pe,
 			      uint32_t child_pe,
@@ -3502,6 +3627,11 @@ static int64_t phb4_creset(struct pci_slot *slot)
 	case PHB4_SLOT_CRESET_START:
 		PHBDBG(p, "CRESET: Starts\n");
 
+		PHBINF(p, "TCE kills: %llu pages (%llu calls), %llu PE, %llu all\n",
+		       p->tce_kill_pages, p->tce_kills[OPAL_PCI_TCE_KILL_PAGES],
+		       p->tce_kills[OPAL_PCI_TCE_KILL_PE],
+		       p->tce_kills[OPAL_PCI_TCE_KILL_ALL]);
+
 		p->creset_start_time = mftb();
 
 		/* circumvention for HW551382 */
@@ -3825,7 +3955,11 @@ static int64_t phb4_eeh_freeze_status(struct phb *phb, uint64_t pe_number,
 		return OPAL_SUCCESS;
 	}
 
-	/* Check the PEEV */
+	/*
+	 * Check the PEEV. The bit is set before the error interrupt is
+	 * taken, so this can't be answered from state that interrupt
+	 * would update. The PESTs are only read for a frozen PE.
+	 */
 	phb4_ioda_sel(p, IODA3_TBL_PEEV, pe_number / 64, false);
 	peev = in_be64(p->regs + PHB_IODA_DATA0);
 	if (!(peev & peev_bit))
@@ -4983,9 +5117,7 @@ static void phb4_p2p_set_initiator(struct phb4 *p, uint16_t pe_number)
 	 */
 	PHBDBG(p, "Setting TVE#1 for peer-to-peer for pe %d\n", pe_number);
 	tve = PPC_BIT(51);
-	phb4_ioda_sel(p, IODA3_TBL_TVT, window_id, false);
-	out_be64(p->regs + PHB_IODA_DATA0, tve);
-	p->tve_cache[window_id] = tve;
+	phb4_set_tve(p, window_id, tve);
 }
 
 static void phb4_p2p_set_target(struct phb4 *p, bool enable)
@@ -5120,6 +5252,8 @@ static const struct phb_ops phb4_ops = {
 	.get_msi_64		= phb4_get_msi_64,
 	.set_pe			= phb4_set_pe,
 	.set_peltv		= phb4_set_peltv,
+	.pe_batch_start		= phb4_pe_batch_start,
+	.pe_batch_end		= phb4_pe_batch_end,
 	.eeh_freeze_status	= phb4_eeh_freeze_status,
 	.eeh_freeze_clear	= phb4_eeh_freeze_clear,
 	.eeh_freeze_set		= phb4_eeh_freeze_set,
@@ -5665,6 +5799,10 @@ static bool phb4_read_capabilities(struct phb4 *p)
 	p->rev = ((val >> 16) & 0x00ff0000) | (val & 0xffff);
 	PHBDBG(p, "Core revision 0x%x\n", p->rev);
 
+	/* HW560152 is fixed on PHB5, page kills can be trusted */
+	if (is_phb5())
+		p->flags |= PHB4_TCE_KILL_RANGE;
+
 	/* Read EEH capabilities */
 	val = in_be64(p->regs + PHB_PHB4_EEH_CAP);
 	if (val == 0xffffffffffffffffUL) {
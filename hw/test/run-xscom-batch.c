@@ -0,0 +1,448 @@
+// SPDX-License-Identifier: Apache-2.0 OR GPL-2.0-or-later
+/*
+ * Test OPAL_XSCOM_BATCH against a fake XSCOM engine and fake
+ * scom_controller backends
+ *
+ * Copyright 2026 IBM Corp.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <assert.h>
+
+#define zalloc(bytes) calloc((bytes), 1)
+
+/* We don't want the real cpu.h, it's PPC-specific */
+#define __CPU_H
+struct cpu_thread {
+	uint32_t	chip_id;
+	uint64_t	current_token;
+};
+static struct cpu_thread fake_cpu;
+static inline struct cpu_thread *this_cpu(void)
+{
+	return &fake_cpu;
+}
+
+#include <processor.h>
+#include <io.h>
+
+/*
+ * The XSCOM engine: a load/store to the XSCOM window is an access and
+ * HMER always reports it done straight away.
+ */
+#define FAKE_REGS	0x100
+static uint64_t fake_regs[FAKE_REGS];
+static unsigned int fake_accesses;
+
+#define mfspr(spr)		fake_mfspr(spr)
+#define mtspr(spr, val)		fake_mtspr(spr, val)
+#define in_be64(addr)		fake_in_be64(addr)
+#define out_be64(addr, val)	fake_out_be64(addr, val)
+
+static unsigned long fake_mfspr(unsigned int spr)
+{
+	assert(spr == SPR_HMER);
+	return SPR_HMER_XSCOM_DONE;
+}
+
+static void fake_mtspr(unsigned int spr, unsigned long val)
+{
+	(void)val;
+	assert(spr == SPR_HMER);
+}
+
+static uint64_t *fake_reg(volatile void *addr)
+{
+	uint64_t pcb_addr = (uint64_t)addr >> 3;
+
+	assert(pcb_addr < FAKE_REGS);
+	fake_accesses++;
+	return &fake_regs[pcb_addr];
+}
+
+static uint64_t fake_in_be64(volatile void *addr)
+{
+	return *fake_reg(addr);
+}
+
+static void fake_out_be64(volatile void *addr, uint64_t val)
+{
+	*fake_reg(addr) = val;
+}
+
+#include "../xscom.c"
+#include "../../ccan/list/list.c"
+
+unsigned long top_of_ram = 0xffffffffffffffffULL;
+enum proc_chip_quirks proc_chip_quirks;
+enum proc_gen proc_gen = proc_gen_p9;
+
+#define FAKE_CHIPS	2
+static struct proc_chip fake_chips[FAKE_CHIPS] = {
+	{ .id = 0 },
+	{ .id = 1 },
+};
+
+struct proc_chip *get_chip(uint32_t chip_id)
+{
+	return chip_id < FAKE_CHIPS ? &fake_chips[chip_id] : NULL;
+}
+
+struct proc_chip *next_chip(struct proc_chip *chip)
+{
+	if (!chip)
+		return &fake_chips[0];
+	if (chip == &fake_chips[FAKE_CHIPS - 1])
+		return NULL;
+	return chip + 1;
+}
+
+/* Acquisitions of the global lock as seen by the lock code */
+static unsigned int global_lock_taken;
+/* Make the next try_lock() fail, as if another thread held the lock */
+static bool fake_contention;
+
+void lock_caller(struct lock *l, const char *caller)
+{
+	(void)caller;
+	assert(!l->lock_val);
+	l->lock_val = 1;
+	if (l == &xscom_lock)
+		global_lock_taken++;
+}
+
+bool try_lock_caller(struct lock *l, const char *caller)
+{
+	if (fake_contention) {
+		fake_contention = false;
+		return false;
+	}
+	lock_caller(l, caller);
+	return true;
+}
+
+void unlock(struct lock *l)
+{
+	assert(l->lock_val);
+	l->lock_val = 0;
+}
+
+int nanosleep_nopoll(const struct timespec *req, struct timespec *rem)
+{
+	(void)req;
+	(void)rem;
+	return 0;
+}
+
+uint32_t log_simple_error(struct opal_err_info *e_info, const char *fmt, ...)
+{
+	(void)e_info;
+	(void)fmt;
+	return 0;
+}
+
+bool lock_held_by_me(struct lock *l)
+{
+	return l->lock_val;
+}
+
+/* Only used by xscom_init() and friends, which we don't call */
+struct dt_node *dt_root;
+
+bool nvram_query_eq_dangerous(const char *key, const char *value)
+{
+	(void)key;
+	(void)value;
+	return false;
+}
+
+u32 dt_get_chip_id(const struct dt_node *node)
+{
+	(void)node;
+	return 0;
+}
+
+const struct dt_property *dt_find_property(const struct dt_node *node,
+					   const char *name)
+{
+	(void)node;
+	(void)name;
+	return NULL;
+}
+
+u64 dt_translate_address(const struct dt_node *node, unsigned int index,
+			 u64 *out_size)
+{
+	(void)node;
+	(void)index;
+	(void)out_size;
+	return 0;
+}
+
+struct dt_node *dt_find_compatible_node(struct dt_node *root,
+					struct dt_node *prev,
+					const char *compat)
+{
+	(void)root;
+	(void)prev;
+	(void)compat;
+	return NULL;
+}
+
+u32 dt_property_get_cell(const struct dt_property *prop, u32 index)
+{
+	(void)prop;
+	(void)index;
+	return 0;
+}
+
+void _prlog(int log_level, const char *fmt, ...)
+{
+	va_list ap;
+
+	(void)log_level;
+	va_start(ap, fmt);
+	vprintf(fmt, ap);
+	va_end(ap);
+}
+
+/* A scom_controller backend, think Centaur */
+#define FAKE_PARTID	0x80000000
+#define FAKE_BAD_ADDR	0xbad
+static uint64_t fake_ctrl_val;
+static unsigned int fake_ctrl_accesses;
+
+static int64_t fake_ctrl_read(struct scom_controller *scom, uint32_t partid,
+			      uint64_t reg, uint64_t *val)
+{
+	(void)scom;
+	assert(partid == FAKE_PARTID);
+	/* Backends issue XSCOMs of their own, the lock must be free */
+	assert(!xscom_lock.lock_val);
+	fake_ctrl_accesses++;
+	if (reg == FAKE_BAD_ADDR)
+		return OPAL_XSCOM_ADDR_ERROR;
+	*val = fake_ctrl_val ^ reg;
+	return OPAL_SUCCESS;
+}
+
+static int64_t fake_ctrl_write(struct scom_controller *scom, uint32_t partid,
+			       uint64_t reg, uint64_t val)
+{
+	(void)scom;
+	assert(partid == FAKE_PARTID);
+	assert(!xscom_lock.lock_val);
+	fake_ctrl_accesses++;
+	if (reg == FAKE_BAD_ADDR)
+		return OPAL_XSCOM_ADDR_ERROR;
+	fake_ctrl_val = val ^ reg;
+	return OPAL_SUCCESS;
+}
+
+static struct scom_controller fake_ctrl = {
+	.part_id = FAKE_PARTID,
+	.read = fake_ctrl_read,
+	.write = fake_ctrl_write,
+};
+
+static void set_op(struct opal_xscom_batch_op *op, uint32_t partid,
+		   uint32_t type, uint64_t addr, uint64_t value, uint64_t mask)
+{
+	op->partid = cpu_to_be32(partid);
+	op->op = cpu_to_be32(type);
+	op->addr = cpu_to_be64(addr);
+	op->value = cpu_to_be64(value);
+	op->mask = cpu_to_be64(mask);
+	op->status = cpu_to_be64(0x5a5a5a5a);
+}
+
+static void test_mixed(void)
+{
+	struct opal_xscom_batch_op ops[9];
+	int i = 0;
+
+	fake_regs[0x10] = 0x1111222233334444ull;
+	fake_regs[0x12] = 0xffff0000ffff0000ull;
+	fake_ctrl_val = 0x1234;
+
+	set_op(&ops[i++], 0, OPAL_XSCOM_BATCH_READ, 0x10, 0, 0);
+	set_op(&ops[i++], 0, OPAL_XSCOM_BATCH_WRITE, 0x11, 0xabcd, 0);
+	set_op(&ops[i++], 0, OPAL_XSCOM_BATCH_WRITE_MASK, 0x12,
+	       0x00ff00ff00ff00ffull, 0x0f0f0f0f0f0f0f0full);
+	set_op(&ops[i++], FAKE_PARTID, OPAL_XSCOM_BATCH_READ, 0x40, 0, 0);
+	set_op(&ops[i++], FAKE_PARTID, OPAL_XSCOM_BATCH_READ, FAKE_BAD_ADDR, 0, 0);
+	set_op(&ops[i++], 0, OPAL_XSCOM_BATCH_READ, 0x11, 0, 0);
+	set_op(&ops[i++], FAKE_PARTID, OPAL_XSCOM_BATCH_WRITE, 0x40, 0x55, 0);
+	set_op(&ops[i++], 0, 42, 0x10, 0, 0);
+	set_op(&ops[i++], 0x20000000, OPAL_XSCOM_BATCH_READ, 0x10, 0, 0);
+
+	global_lock_taken = 0;
+	fake_ctrl_accesses = 0;
+	assert(opal_xscom_batch(ops, i) == OPAL_SUCCESS);
+	assert(!xscom_lock.lock_val);
+	assert(fake_ctrl_accesses == 3);
+
+	/* Chip read */
+	assert(be64_to_cpu(ops[0].status) == OPAL_SUCCESS);
+	assert(be64_to_cpu(ops[0].value) == 0x1111222233334444ull);
+	/* Chip write */
+	assert(be64_to_cpu(ops[1].status) == OPAL_SUCCESS);
+	assert(fake_regs[0x11] == 0xabcd);
+	/* Chip read-modify-write */
+	assert(be64_to_cpu(ops[2].status) == OPAL_SUCCESS);
+	assert(fake_regs[0x12] == 0xf0ff000ff0ff000full);
+	/* Backend read, then a failing one which doesn't stop the batch */
+	assert(be64_to_cpu(ops[3].status) == OPAL_SUCCESS);
+	assert(be64_to_cpu(ops[3].value) == (0x1234 ^ 0x40));
+	assert(be64_to_cpu(ops[4].status) == (uint64_t)OPAL_XSCOM_ADDR_ERROR);
+	/* Reads see earlier writes of the same batch */
+	assert(be64_to_cpu(ops[5].status) == OPAL_SUCCESS);
+	assert(be64_to_cpu(ops[5].value) == 0xabcd);
+	/* Backend write */
+	assert(be64_to_cpu(ops[6].status) == OPAL_SUCCESS);
+	assert(fake_ctrl_val == (0x55 ^ 0x40));
+	/* Unknown op and unknown partid */
+	assert(be64_to_cpu(ops[7].status) == (uint64_t)OPAL_PARAMETER);
+	assert(be64_to_cpu(ops[8].status) == (uint64_t)OPAL_PARAMETER);
+
+	/* Chip runs: 0-2, 5, 7 */
+	assert(global_lock_taken == 3);
+}
+
+static void test_one_lock(void)
+{
+	struct opal_xscom_batch_op ops[OPAL_XSCOM_BATCH_MAX];
+	unsigned int i;
+
+	for (i = 0; i < FAKE_REGS; i++)
+		fake_regs[i] = i * 0x0101010101010101ull;
+
+	for (i = 0; i < OPAL_XSCOM_BATCH_MAX; i++)
+		set_op(&ops[i], 0, OPAL_XSCOM_BATCH_READ, i % FAKE_REGS, 0, 0);
+
+	/* One at a time, one lock per SCOM */
+	global_lock_taken = 0;
+	for (i = 0; i < OPAL_XSCOM_BATCH_MAX; i++) {
+		uint64_t val;
+
+		assert(xscom_read(0, i % FAKE_REGS, &val) == OPAL_SUCCESS);
+		assert(val == (i % FAKE_REGS) * 0x0101010101010101ull);
+	}
+	printf("single: %u SCOMs, %u lock acquisitions\n",
+	       OPAL_XSCOM_BATCH_MAX, global_lock_taken);
+	assert(global_lock_taken == OPAL_XSCOM_BATCH_MAX);
+
+	/* Batched, one lock for the lot */
+	global_lock_taken = 0;
+	fake_accesses = 0;
+	assert(opal_xscom_batch(ops, OPAL_XSCOM_BATCH_MAX) == OPAL_SUCCESS);
+	printf("batch:  %u SCOMs, %u lock acquisitions\n",
+	       fake_accesses, global_lock_taken);
+	assert(global_lock_taken == 1);
+	assert(fake_accesses == OPAL_XSCOM_BATCH_MAX);
+
+	for (i = 0; i < OPAL_XSCOM_BATCH_MAX; i++) {
+		assert(be64_to_cpu(ops[i].status) == OPAL_SUCCESS);
+		assert(be64_to_cpu(ops[i].value) ==
+		       (i % FAKE_REGS) * 0x0101010101010101ull);
+	}
+}
+
+static void test_per_chip_lock(void)
+{
+	struct opal_xscom_batch_op ops[8];
+	uint64_t val;
+	int i = 0;
+
+	xscom_per_chip_lock = true;
+	global_lock_taken = 0;
+
+	/* Chip 0, chip 1, a backend in between, then chip 0 again */
+	set_op(&ops[i++], 0, OPAL_XSCOM_BATCH_WRITE, 0x20, 0x20, 0);
+	set_op(&ops[i++], 0, OPAL_XSCOM_BATCH_READ, 0x20, 0, 0);
+	set_op(&ops[i++], 1, OPAL_XSCOM_BATCH_WRITE, 0x21, 0x21, 0);
+	set_op(&ops[i++], 1, OPAL_XSCOM_BATCH_READ, 0x21, 0, 0);
+	set_op(&ops[i++], FAKE_PARTID, OPAL_XSCOM_BATCH_READ, 0x40, 0, 0);
+	set_op(&ops[i++], 1, OPAL_XSCOM_BATCH_READ, 0x20, 0, 0);
+	set_op(&ops[i++], 0, OPAL_XSCOM_BATCH_READ, 0x21, 0, 0);
+	set_op(&ops[i++], 0, OPAL_XSCOM_BATCH_READ, 0x22, 0, 0);
+
+	assert(opal_xscom_batch(ops, i) == OPAL_SUCCESS);
+	for (i = 0; i < 8; i++)
+		assert(be64_to_cpu(ops[i].status) == OPAL_SUCCESS);
+	assert(!fake_chips[0].xscom_lock.lock_val);
+	assert(!fake_chips[1].xscom_lock.lock_val);
+
+	/* Chip runs: 0-1, 2-3, 5, 6-7 */
+	assert(fake_chips[0].xscom_lock_taken == 2);
+	assert(fake_chips[1].xscom_lock_taken == 2);
+	assert(global_lock_taken == 0);
+
+	/* Single SCOMs only take the lock of their chip */
+	assert(xscom_read(1, 0x20, &val) == OPAL_SUCCESS);
+	assert(fake_chips[0].xscom_lock_taken == 2);
+	assert(fake_chips[1].xscom_lock_taken == 3);
+
+	/* Waiting for the lock is counted */
+	fake_contention = true;
+	assert(xscom_read(0, 0x20, &val) == OPAL_SUCCESS);
+	assert(fake_chips[0].xscom_lock_taken == 3);
+	assert(fake_chips[0].xscom_lock_contended == 1);
+	assert(fake_chips[1].xscom_lock_contended == 0);
+
+	/* Chips that don't exist are refused before we look for a lock */
+	fake_accesses = 0;
+	assert(xscom_read(FAKE_CHIPS, 0x20, &val) == OPAL_PARAMETER);
+	assert(xscom_write(FAKE_CHIPS, 0x20, 0) == OPAL_PARAMETER);
+	i = 0;
+	set_op(&ops[i++], 0, OPAL_XSCOM_BATCH_READ, 0x20, 0, 0);
+	set_op(&ops[i++], FAKE_CHIPS, OPAL_XSCOM_BATCH_READ, 0x20, 0, 0);
+	set_op(&ops[i++], 0x0ffffff0, OPAL_XSCOM_BATCH_WRITE, 0x20, 0, 0);
+	set_op(&ops[i++], 0, OPAL_XSCOM_BATCH_READ, 0x21, 0, 0);
+	assert(opal_xscom_batch(ops, i) == OPAL_SUCCESS);
+	assert(be64_to_cpu(ops[0].status) == OPAL_SUCCESS);
+	assert(be64_to_cpu(ops[1].status) == (uint64_t)OPAL_PARAMETER);
+	assert(be64_to_cpu(ops[2].status) == (uint64_t)OPAL_PARAMETER);
+	assert(be64_to_cpu(ops[3].status) == OPAL_SUCCESS);
+	assert(fake_accesses == 2);
+	assert(!fake_chips[0].xscom_lock.lock_val);
+	assert(!xscom_lock.lock_val);
+
+	assert(xscom_ok());
+	xscom_dump_stats();
+
+	xscom_per_chip_lock = false;
+	assert(global_lock_taken == 0);
+}
+
+static void test_bad_args(void)
+{
+	struct opal_xscom_batch_op ops[OPAL_XSCOM_BATCH_MAX + 1];
+
+	set_op(&ops[0], 0, OPAL_XSCOM_BATCH_READ, 0x10, 0, 0);
+
+	fake_accesses = 0;
+	assert(opal_xscom_batch(ops, 0) == OPAL_PARAMETER);
+	assert(opal_xscom_batch(ops, OPAL_XSCOM_BATCH_MAX + 1) ==
+	       OPAL_PARAMETER);
+	assert(opal_xscom_batch((void *)0x8000000000000000ull, 1) ==
+	       OPAL_PARAMETER);
+	assert(fake_accesses == 0);
+	assert(be64_to_cpu(ops[0].status) == 0x5a5a5a5a);
+}
+
+int main(void)
+{
+	assert(scom_register(&fake_ctrl) == 0);
+
+	test_mixed();
+	test_one_lock();
+	test_per_chip_lock();
+	test_bad_args();
+
+	return 0;
+}
@@ -0,0 +1,318 @@
+// SPDX-License-Identifier: Apache-2.0 OR GPL-2.0-or-later
+/*
+ * Test the XSCOM read cache against a fake XSCOM engine
+ *
+ * Copyright 2026 IBM Corp.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <ccan/array_size/array_size.h>
+
+#define zalloc(bytes) calloc((bytes), 1)
+
+/* We don't want the real cpu.h, it's PPC-specific */
+#define __CPU_H
+struct cpu_thread {
+	uint32_t	chip_id;
+	uint64_t	current_token;
+};
+static struct cpu_thread fake_cpu;
+static inline struct cpu_thread *this_cpu(void)
+{
+	return &fake_cpu;
+}
+
+#include <processor.h>
+#include <io.h>
+
+/*
+ * The XSCOM engine: a handful of registers, each chip has its own
+ * XSCOM window starting at FAKE_CHIP_BASE(chip)
+ */
+#define FAKE_CHIP_BASE(c)	((uint64_t)(c) << 40)
+
+static struct {
+	uint32_t	addr;
+	uint64_t	val[2];
+} fake_regs[] = {
+	{ 0x000f000f, { 0x220da04980000000ull, 0x220da04980000000ull } },
+	{ 0x01010cda, { 0x1000, 0x2000 } },
+	{ 0x01010cde, { 0x0ff0, 0x0ff0 } },
+	{ 0x0201108d, { 0x3000, 0x4000 } },
+	{ 0x00012345, { 0x5000, 0x6000 } },
+};
+static unsigned int fake_accesses;
+
+#define mfspr(spr)		fake_mfspr(spr)
+#define mtspr(spr, val)		fake_mtspr(spr, val)
+#define in_be64(addr)		fake_in_be64(addr)
+#define out_be64(addr, val)	fake_out_be64(addr, val)
+
+static unsigned long fake_mfspr(unsigned int spr)
+{
+	assert(spr == SPR_HMER);
+	return SPR_HMER_XSCOM_DONE;
+}
+
+static void fake_mtspr(unsigned int spr, unsigned long val)
+{
+	(void)val;
+	assert(spr == SPR_HMER);
+}
+
+static uint64_t *fake_reg(volatile void *addr)
+{
+	unsigned int chip = (uint64_t)addr >> 40;
+	uint32_t pcb_addr = ((uint64_t)addr & (FAKE_CHIP_BASE(1) - 1)) >> 3;
+	unsigned int i;
+
+	assert(chip < 2);
+	fake_accesses++;
+	for (i = 0; i < ARRAY_SIZE(fake_regs); i++)
+		if (fake_regs[i].addr == pcb_addr)
+			return &fake_regs[i].val[chip];
+	assert(0);
+	return NULL;
+}
+
+static uint64_t fake_in_be64(volatile void *addr)
+{
+	return *fake_reg(addr);
+}
+
+static void fake_out_be64(volatile void *addr, uint64_t val)
+{
+	*fake_reg(addr) = val;
+}
+
+#include "../xscom.c"
+#include "../../ccan/list/list.c"
+
+unsigned long top_of_ram = 0xffffffffffffffffULL;
+enum proc_chip_quirks proc_chip_quirks;
+enum proc_gen proc_gen = proc_gen_p10;
+
+#define FAKE_CHIPS	2
+static struct proc_chip fake_chips[FAKE_CHIPS] = {
+	{ .id = 0, .xscom_base = FAKE_CHIP_BASE(0) },
+	{ .id = 1, .xscom_base = FAKE_CHIP_BASE(1) },
+};
+
+struct proc_chip *get_chip(uint32_t chip_id)
+{
+	return chip_id < FAKE_CHIPS ? &fake_chips[chip_id] : NULL;
+}
+
+struct proc_chip *next_chip(struct proc_chip *chip)
+{
+	if (!chip)
+		return &fake_chips[0];
+	if (chip == &fake_chips[FAKE_CHIPS - 1])
+		return NULL;
+	return chip + 1;
+}
+
+void lock_caller(struct lock *l, const char *caller)
+{
+	(void)caller;
+	assert(!l->lock_val);
+	l->lock_val = 1;
+}
+
+bool try_lock_caller(struct lock *l, const char *caller)
+{
+	lock_caller(l, caller);
+	return true;
+}
+
+void unlock(struct lock *l)
+{
+	assert(l->lock_val);
+	l->lock_val = 0;
+}
+
+bool lock_held_by_me(struct lock *l)
+{
+	return l->lock_val;
+}
+
+int nanosleep_nopoll(const struct timespec *req, struct timespec *rem)
+{
+	(void)req;
+	(void)rem;
+	return 0;
+}
+
+uint32_t log_simple_error(struct opal_err_info *e_info, const char *fmt, ...)
+{
+	(void)e_info;
+	(void)fmt;
+	return 0;
+}
+
+/* Only used by xscom_init() and friends, which we don't call */
+struct dt_node *dt_root;
+
+bool nvram_query_eq_dangerous(const char *key, const char *value)
+{
+	(void)key;
+	(void)value;
+	return false;
+}
+
+u32 dt_get_chip_id(const struct dt_node *node)
+{
+	(void)node;
+	return 0;
+}
+
+const struct dt_property *dt_find_property(const struct dt_node *node,
+					   const char *name)
+{
+	(void)node;
+	(void)name;
+	return NULL;
+}
+
+u64 dt_translate_address(const struct dt_node *node, unsigned int index,
+			 u64 *out_size)
+{
+	(void)node;
+	(void)index;
+	(void)out_size;
+	return 0;
+}
+
+struct dt_node *dt_find_compatible_node(struct dt_node *root,
+					struct dt_node *prev,
+					const char *compat)
+{
+	(void)root;
+	(void)prev;
+	(void)compat;
+	return NULL;
+}
+
+u32 dt_property_get_cell(const struct dt_property *prop, u32 index)
+{
+	(void)prop;
+	(void)index;
+	return 0;
+}
+
+void _prlog(int log_level, const char *fmt, ...)
+{
+	va_list ap;
+
+	(void)log_level;
+	va_start(ap, fmt);
+	vprintf(fmt, ap);
+	va_end(ap);
+}
+
+static uint64_t read_cached(uint32_t chip, uint64_t addr)
+{
+	uint64_t val;
+
+	assert(xscom_read_cached(chip, addr, &val) == OPAL_SUCCESS);
+	assert(!fake_chips[chip].xscom_lock.lock_val);
+	return val;
+}
+
+static void test_cache(void)
+{
+	struct xscom_cache *c0 = fake_chips[0].xscom_cache;
+	struct xscom_cache *c1 = fake_chips[1].xscom_cache;
+	unsigned int i;
+	uint32_t id;
+
+	/* Misses fill the cache, hits don't touch the hardware */
+	fake_accesses = 0;
+	for (i = 0; i < 100; i++) {
+		assert(read_cached(0, 0x01010cda) == 0x1000);
+		assert(read_cached(1, 0x01010cda) == 0x2000);
+		assert(xscom_read_cfam_chipid(0, &id) == OPAL_SUCCESS);
+		assert(id == 0x220da);
+	}
+	printf("100 x 3 cached reads: %u SCOMs, %llu hits, %llu misses\n",
+	       fake_accesses, (unsigned long long)(c0->hits + c1->hits),
+	       (unsigned long long)(c0->misses + c1->misses));
+	assert(fake_accesses == 3);
+	assert(c0->misses == 2 && c0->hits == 198);
+	assert(c1->misses == 1 && c1->hits == 99);
+
+	/* Uncacheable addresses always go to the hardware */
+	fake_accesses = 0;
+	assert(read_cached(0, 0x00012345) == 0x5000);
+	assert(read_cached(0, 0x00012345) == 0x5000);
+	assert(fake_accesses == 2);
+	assert(c0->misses == 2 && c0->hits == 198);
+
+	/* A write invalidates the entry of that chip only */
+	assert(xscom_write(0, 0x01010cda, 0x1001) == OPAL_SUCCESS);
+	fake_accesses = 0;
+	assert(read_cached(0, 0x01010cda) == 0x1001);
+	assert(read_cached(1, 0x01010cda) == 0x2000);
+	assert(fake_accesses == 1);
+
+	/* Changes behind our back need an explicit invalidate */
+	assert(read_cached(1, 0x0201108d) == 0x4000);
+	fake_regs[3].val[1] = 0x4001;
+	assert(read_cached(1, 0x0201108d) == 0x4000);
+	xscom_cache_invalidate(1, 0x0201108d);
+	assert(read_cached(1, 0x0201108d) == 0x4001);
+
+	/* And a flush drops all of them */
+	assert(read_cached(1, 0x01010cde) == 0x0ff0);
+	fake_regs[1].val[1] = 0x2001;
+	fake_regs[2].val[1] = 0x0ff1;
+	assert(read_cached(1, 0x01010cda) == 0x2000);
+	assert(read_cached(1, 0x01010cde) == 0x0ff0);
+	xscom_cache_flush(1);
+	fake_accesses = 0;
+	assert(read_cached(1, 0x01010cda) == 0x2001);
+	assert(read_cached(1, 0x01010cde) == 0x0ff1);
+	assert(read_cached(0, 0x01010cda) == 0x1001);
+	assert(fake_accesses == 2);
+
+	xscom_dump_stats();
+}
+
+static void test_no_cache(void)
+{
+	uint64_t val;
+
+	/* Without a table for this proc_gen nothing is cached */
+	proc_gen = proc_gen_unknown;
+	fake_accesses = 0;
+	assert(xscom_read_cached(0, 0x01010cda, &val) == OPAL_SUCCESS);
+	assert(xscom_read_cached(0, 0x01010cda, &val) == OPAL_SUCCESS);
+	assert(fake_accesses == 2);
+	proc_gen = proc_gen_p10;
+
+	/* Nor for EX chiplets or other partids */
+	assert(!xscom_cache_get(0x40000000, 0x01010cda));
+	assert(!xscom_cache_get(0x80000000, 0x01010cda));
+}
+
+int main(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < FAKE_CHIPS; i++)
+		fake_chips[i].xscom_cache = zalloc(sizeof(struct xscom_cache));
+	xscom_per_chip_lock = true;
+
+	test_cache();
+	test_no_cache();
+
+	for (i = 0; i < FAKE_CHIPS; i++)
+		free(fake_chips[i].xscom_cache);
+
+	return 0;
+}
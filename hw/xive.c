@@ -463,6 +463,16 @@ struct xive {
 
 	/* In memory queue overflow */
 	void		*q_ovf;
+
+	/* Cache watch updates done between xive_cache_batch_start() and
+	 * xive_cache_batch_end() are only scrubbed at the end, once per
+	 * cache and block. These are bitmaps of the blocks to scrub and
+	 * the last EQ updated, for the scrub HW bug workaround.
+	 */
+	bool		cache_batch;
+	uint32_t	cache_batch_eq_blks;
+	uint32_t	cache_batch_vp_blks;
+	uint32_t	cache_batch_eq_idx;
 };
 
 #define XIVE_CAN_STORE_EOI(x) XIVE_STORE_EOI_ENABLED
@@ -579,6 +589,25 @@ static uint32_t xive_chips_alloc_bits = 0;
 static struct buddy *xive_vp_buddy;
 static struct lock xive_buddy_lock = LOCK_UNLOCKED;
 
+/* Per-chip VP pools.
+ *
+ * Freed VP blocks of the common small orders are parked in the pool
+ * of the chip that freed them and handed out again without going
+ * through the global buddy, trying the local chip first. The VP
+ * number encoding stripes every block across all chips, so a pooled
+ * block is still provisioned on all of them: the pools only shard
+ * the lock and keep guest start/stop churn out of the buddy.
+ */
+#define XIVE_VP_POOL_ORDERS	8
+#define XIVE_VP_POOL_DEPTH	8
+
+struct xive_vp_pool {
+	struct lock	lock;
+	uint32_t	count[XIVE_VP_POOL_ORDERS];
+	uint32_t	idx[XIVE_VP_POOL_ORDERS][XIVE_VP_POOL_DEPTH];
+};
+static struct xive_vp_pool xive_vp_pools[XIVE_MAX_CHIPS];
+
 /* VP# decoding/encoding */
 static bool xive_decode_vp(uint32_t vp, uint32_t *blk, uint32_t *idx,
 			   uint8_t *order, bool *group)
@@ -978,6 +1007,8 @@ static bool xive_provision_vp_ind(struct xive *x, uint32_t vp_idx, uint32_t orde
 
 static void xive_init_vp_allocator(void)
 {
+	unsigned int i;
+
 	/* Initialize chip alloc bits */
 	xive_chips_alloc_bits = ilog2(xive_block_count);
 
@@ -999,6 +1030,94 @@ static void xive_init_vp_allocator(void)
 	 */
 	assert(buddy_reserve(xive_vp_buddy, XIVE_HW_VP_BASE,
 			     XIVE_THREADID_SHIFT));
+
+	for (i = 0; i < XIVE_MAX_CHIPS; i++)
+		init_lock(&xive_vp_pools[i].lock);
+}
+
+static struct xive_vp_pool *xive_vp_local_pool(uint32_t *home)
+{
+	struct proc_chip *c = get_chip(this_cpu()->chip_id);
+
+	*home = (c && c->xive) ? c->xive->block_id : 0;
+	return &xive_vp_pools[*home];
+}
+
+static int xive_vp_pool_get(uint32_t local_order)
+{
+	struct xive_vp_pool *p;
+	uint32_t home, i;
+	int vp = -1;
+
+	if (local_order >= XIVE_VP_POOL_ORDERS)
+		return -1;
+
+	/* Local chip first, then steal from the others */
+	xive_vp_local_pool(&home);
+	for (i = 0; i < xive_block_count && vp < 0; i++) {
+		p = &xive_vp_pools[(home + i) % xive_block_count];
+
+		/* Unlocked peek, re-checked under the lock */
+		if (!p->count[local_order])
+			continue;
+		lock(&p->lock);
+		if (p->count[local_order])
+			vp = p->idx[local_order][--p->count[local_order]];
+		unlock(&p->lock);
+	}
+	return vp;
+}
+
+static bool xive_vp_pool_put(uint32_t idx, uint32_t local_order)
+{
+	struct xive_vp_pool *p;
+	uint32_t home;
+	bool pooled = false;
+
+	if (local_order >= XIVE_VP_POOL_ORDERS)
+		return false;
+
+	p = xive_vp_local_pool(&home);
+	lock(&p->lock);
+	if (p->count[local_order] < XIVE_VP_POOL_DEPTH) {
+		p->idx[local_order][p->count[local_order]++] = idx;
+		pooled = true;
+	}
+	unlock(&p->lock);
+	return pooled;
+}
+
+/* Give all pooled blocks back to the buddy so they can coalesce */
+static void xive_vp_pools_drain(void)
+{
+	struct xive_vp_pool *p;
+	uint32_t i, o;
+
+	for (i = 0; i < xive_block_count; i++) {
+		p = &xive_vp_pools[i];
+		lock(&p->lock);
+		lock(&xive_buddy_lock);
+		for (o = 0; o < XIVE_VP_POOL_ORDERS; o++) {
+			while (p->count[o])
+				buddy_free(xive_vp_buddy,
+					   p->idx[o][--p->count[o]], o);
+		}
+		unlock(&xive_buddy_lock);
+		unlock(&p->lock);
+	}
+}
+
+/* On reset the buddy is wiped, just forget about the pooled blocks */
+static void xive_vp_pools_reset(void)
+{
+	uint32_t i;
+
+	for (i = 0; i < xive_block_count; i++) {
+		lock(&xive_vp_pools[i].lock);
+		memset(xive_vp_pools[i].count, 0,
+		       sizeof(xive_vp_pools[i].count));
+		unlock(&xive_vp_pools[i].lock);
+	}
 }
 
 static uint32_t xive_alloc_vps(uint32_t order)
@@ -1013,11 +1132,23 @@ static uint32_t xive_alloc_vps(uint32_t order)
 	/* We split the allocation */
 	local_order = order - xive_chips_alloc_bits;
 
+	/* Fast path: a pooled block, already provisioned everywhere */
+	vp = xive_vp_pool_get(local_order);
+	if (vp >= 0)
+		return xive_encode_vp(0, vp, order);
+
 	/* We grab that in the global buddy */
 	assert(xive_vp_buddy);
 	lock(&xive_buddy_lock);
 	vp = buddy_alloc(xive_vp_buddy, local_order);
 	unlock(&xive_buddy_lock);
+	if (vp < 0) {
+		/* The pools may be sitting on the buddies we need */
+		xive_vp_pools_drain();
+		lock(&xive_buddy_lock);
+		vp = buddy_alloc(xive_vp_buddy, local_order);
+		unlock(&xive_buddy_lock);
+	}
 	if (vp < 0)
 		return XIVE_ALLOC_NO_SPACE;
 
@@ -1055,6 +1186,10 @@ static void xive_free_vps(uint32_t vp)
 	/* We split the allocation */
 	local_order = order - xive_chips_alloc_bits;
 
+	/* Keep it around for the next guest if the local pool has room */
+	if (xive_vp_pool_put(idx, local_order))
+		return;
+
 	/* Free that in the buddy */
 	lock(&xive_buddy_lock);
 	buddy_free(xive_vp_buddy, idx, local_order);
@@ -1111,9 +1246,15 @@ static void xive_scrub_workaround_eq(struct xive *x, uint32_t block __unused, ui
 	load_wait(in_be64(mmio + XIVE_ESB_GET));
 }
 
-static int64_t __xive_cache_scrub(struct xive *x, enum xive_cache_type ctype,
-				  uint64_t block, uint64_t idx,
-				  bool want_inval, bool want_disable)
+/*
+ * Scrub the entries matching idx under idx_mask, all ones to scrub a
+ * single entry and zero to scrub the whole block
+ */
+static int64_t __xive_cache_scrub_mask(struct xive *x,
+				       enum xive_cache_type ctype,
+				       uint64_t block, uint64_t idx,
+				       uint64_t idx_mask,
+				       bool want_inval, bool want_disable)
 {
 	uint64_t sreg, sregx, mreg, mregx;
 	uint64_t mval, sval;
@@ -1165,11 +1306,11 @@ static int64_t __xive_cache_scrub(struct xive *x, enum xive_cache_type ctype,
 		return OPAL_INTERNAL_ERROR;
 	}
 	if (ctype == xive_cache_vpc) {
-		mval = PC_SCRUB_BLOCK_ID | PC_SCRUB_OFFSET;
+		mval = SETFIELD(PC_SCRUB_OFFSET, PC_SCRUB_BLOCK_ID, idx_mask);
 		sval = SETFIELD(PC_SCRUB_BLOCK_ID, idx, block) |
 			PC_SCRUB_VALID;
 	} else {
-		mval = VC_SCRUB_BLOCK_ID | VC_SCRUB_OFFSET;
+		mval = SETFIELD(VC_SCRUB_OFFSET, VC_SCRUB_BLOCK_ID, idx_mask);
 		sval = SETFIELD(VC_SCRUB_BLOCK_ID, idx, block) |
 			VC_SCRUB_VALID;
 	}
@@ -1202,6 +1343,14 @@ static int64_t __xive_cache_scrub(struct xive *x, enum xive_cache_type ctype,
 	return 0;
 }
 
+static int64_t __xive_cache_scrub(struct xive *x, enum xive_cache_type ctype,
+				  uint64_t block, uint64_t idx,
+				  bool want_inval, bool want_disable)
+{
+	return __xive_cache_scrub_mask(x, ctype, block, idx, ~0ull,
+				       want_inval, want_disable);
+}
+
 static int64_t xive_ivc_scrub(struct xive *x, uint64_t block, uint64_t idx)
 {
 	/* IVC has no "want_inval" bit, it always invalidates */
@@ -1315,12 +1464,65 @@ static int64_t __xive_cache_watch(struct xive *x, enum xive_cache_type ctype,
 		}
 	}
 
+	/* In a batch, leave the scrub to xive_cache_batch_end() */
+	if (x->cache_batch) {
+		if (ctype == xive_cache_eqc) {
+			x->cache_batch_eq_blks |= 1u << block;
+			x->cache_batch_eq_idx = idx;
+		} else
+			x->cache_batch_vp_blks |= 1u << block;
+		return 0;
+	}
+
 	/* Perform a scrub with "want_invalidate" set to false to push the
 	 * cache updates to memory as well
 	 */
 	return __xive_cache_scrub(x, ctype, block, idx, false, false);
 }
 
+/*
+ * Batched cache updates: between these two calls, cache watches only
+ * update the cache and the scrubs pushing the updates to memory are
+ * done at the end, one for each block of each cache. Nothing may rely
+ * on the in-memory EQ/VP content before xive_cache_batch_end().
+ */
+static void xive_cache_batch_start(struct xive *x)
+{
+#ifdef XIVE_CHECK_LOCKS
+	assert(lock_held_by_me(&x->lock));
+#endif
+	assert(!x->cache_batch);
+	x->cache_batch = true;
+}
+
+static int64_t xive_cache_batch_end(struct xive *x)
+{
+	int64_t rc, ret = 0;
+	uint32_t blk;
+
+	x->cache_batch = false;
+
+	for (blk = 0; blk < 32; blk++) {
+		if (x->cache_batch_eq_blks & (1u << blk)) {
+			rc = __xive_cache_scrub_mask(x, xive_cache_eqc, blk,
+						     x->cache_batch_eq_idx, 0,
+						     false, false);
+			if (rc && !ret)
+				ret = rc;
+		}
+		if (x->cache_batch_vp_blks & (1u << blk)) {
+			rc = __xive_cache_scrub_mask(x, xive_cache_vpc, blk,
+						     0, 0, false, false);
+			if (rc && !ret)
+				ret = rc;
+		}
+	}
+	x->cache_batch_eq_blks = 0;
+	x->cache_batch_vp_blks = 0;
+
+	return ret;
+}
+
 static int64_t xive_escalation_ive_cache_update(struct xive *x, uint64_t block,
 				     uint64_t idx, struct xive_ive *ive,
 				     bool synchronous)
@@ -1831,12 +2033,8 @@ static void late_init_one_xive(struct xive *x)
 
 static bool xive_check_ipi_free(struct xive *x, uint32_t irq, uint32_t count)
 {
-	uint32_t i, idx = GIRQ_TO_IDX(irq);
-
-	for (i = 0; i < count; i++)
-		if (bitmap_tst_bit(*x->ipi_alloc_map, idx + i))
-			return false;
-	return true;
+	return bitmap_find_one_bit(*x->ipi_alloc_map, GIRQ_TO_IDX(irq),
+				   count) < 0;
 }
 
 uint32_t xive_alloc_hw_irqs(uint32_t chip_id, uint32_t count, uint32_t align)
@@ -2326,9 +2524,34 @@ static int64_t xive_sync(struct xive *x)
 	return 0;
 }
 
-static int64_t __xive_set_irq_config(struct irq_source *is, uint32_t girq,
-				     uint64_t vp, uint8_t prio, uint32_t lirq,
-				     bool update_esb, bool sync)
+/* XIVEs to sync once a set of interrupts has been reconfigured */
+struct xive_sync_set {
+	uint64_t	src_chips;
+	uint64_t	tgt_chips;
+};
+
+static void xive_sync_set_run(struct xive_sync_set *ss)
+{
+	struct proc_chip *chip;
+
+	/* Sources first, then the old targets, as for a single irq */
+	for_each_chip(chip)
+		if (chip->xive && (ss->src_chips & (1ull << chip->id)))
+			xive_sync(chip->xive);
+	for_each_chip(chip)
+		if (chip->xive && (ss->tgt_chips & (1ull << chip->id)))
+			xive_sync(chip->xive);
+}
+
+/*
+ * Reconfigure an interrupt and add the XIVEs that need a sync for it
+ * to the set, see __xive_set_irq_config()
+ */
+static int64_t xive_set_irq_config_deferred(struct irq_source *is,
+					    uint32_t girq, uint64_t vp,
+					    uint8_t prio, uint32_t lirq,
+					    bool update_esb,
+					    struct xive_sync_set *ss)
 {
 	struct xive_src *s = container_of(is, struct xive_src, is);
 	uint32_t old_target, vp_blk;
@@ -2372,18 +2595,33 @@ static int64_t __xive_set_irq_config(struct irq_source *is, uint32_t girq,
 	 * WARNING: This assumes the VP and it's queues are on the same
 	 *          XIVE instance !
 	 */
-	if (!sync)
-		return OPAL_SUCCESS;
-	xive_sync(s->xive);
+	ss->src_chips |= 1ull << s->xive->chip_id;
 	if (xive_decode_vp(old_target, &vp_blk, NULL, NULL, NULL)) {
 		struct xive *x = xive_from_pc_blk(vp_blk);
 		if (x)
-			xive_sync(x);
+			ss->tgt_chips |= 1ull << x->chip_id;
 	}
 
 	return OPAL_SUCCESS;
 }
 
+static int64_t __xive_set_irq_config(struct irq_source *is, uint32_t girq,
+				     uint64_t vp, uint8_t prio, uint32_t lirq,
+				     bool update_esb, bool sync)
+{
+	struct xive_sync_set ss = { 0, 0 };
+	int64_t rc;
+
+	rc = xive_set_irq_config_deferred(is, girq, vp, prio, lirq,
+					  update_esb, &ss);
+	if (rc || !sync)
+		return rc;
+
+	xive_sync_set_run(&ss);
+
+	return OPAL_SUCCESS;
+}
+
 static int64_t xive_set_irq_config(uint32_t girq, uint64_t vp, uint8_t prio,
 				   uint32_t lirq, bool update_esb)
 {
@@ -3801,6 +4039,48 @@ static int64_t opal_xive_set_irq_config(uint32_t girq,
 	return xive_set_irq_config(girq, vp, prio, lirq, false);
 }
 
+/*
+ * Vectored OPAL_XIVE_SET_IRQ_CONFIG: reconfigure up to
+ * OPAL_XIVE_IRQ_CONFIG_MAX interrupts, each with its own status, and
+ * sync each XIVE involved once at the end rather than once per
+ * interrupt.
+ */
+static int64_t opal_xive_set_irq_configs(struct opal_xive_irq_config *cfgs,
+					 uint64_t count)
+{
+	struct xive_sync_set ss = { 0, 0 };
+	uint64_t i;
+
+	if (xive_mode != XIVE_MODE_EXPL)
+		return OPAL_WRONG_STATE;
+	if (!count || count > OPAL_XIVE_IRQ_CONFIG_MAX ||
+	    !opal_addr_valid(cfgs))
+		return OPAL_PARAMETER;
+
+	for (i = 0; i < count; i++) {
+		struct opal_xive_irq_config *cfg = &cfgs[i];
+		uint32_t girq = be32_to_cpu(cfg->girq);
+		uint32_t prio = be32_to_cpu(cfg->prio);
+		struct irq_source *is = irq_find_source(girq);
+		int64_t rc;
+
+		/* Same as OPAL_XIVE_SET_IRQ_CONFIG, ESBs are left alone */
+		if (!is || prio > 0xff)
+			rc = OPAL_PARAMETER;
+		else
+			rc = xive_set_irq_config_deferred(is, girq,
+							  be64_to_cpu(cfg->vp),
+							  prio,
+							  be32_to_cpu(cfg->lirq),
+							  false, &ss);
+		cfg->status = cpu_to_be64(rc);
+	}
+
+	xive_sync_set_run(&ss);
+
+	return OPAL_SUCCESS;
+}
+
 static int64_t opal_xive_get_queue_info(uint64_t vp, uint32_t prio,
 					__be64 *out_qpage,
 					__be64 *out_qsize,
@@ -3890,10 +4170,15 @@ static void xive_cleanup_eq(struct xive_eq *eq)
 	eq->w2 = eq->w3 = eq->w4 = eq->w5 = eq->w6 = eq->w7 = 0;
 }
 
-static int64_t opal_xive_set_queue_info(uint64_t vp, uint32_t prio,
-					uint64_t qpage,
-					uint64_t qsize,
-					uint64_t qflags)
+/*
+ * Build the new EQ for a queue configuration, which the caller then
+ * commits with the cache watch facility
+ */
+static int64_t xive_prepare_queue_info(uint64_t vp, uint32_t prio,
+				       uint64_t qpage, uint64_t qsize,
+				       uint64_t qflags, struct xive **out_x,
+				       uint32_t *out_blk, uint32_t *out_idx,
+				       struct xive_eq *out_eq)
 {
 	uint32_t blk, idx;
 	struct xive *x;
@@ -3901,10 +4186,7 @@ static int64_t opal_xive_set_queue_info(uint64_t vp, uint32_t prio,
 	struct xive_eq eq;
 	uint32_t vp_blk, vp_idx;
 	bool group;
-	int64_t rc;
 
-	if (xive_mode != XIVE_MODE_EXPL)
-		return OPAL_WRONG_STATE;
 	if (!xive_eq_for_target(vp, prio, &blk, &idx))
 		return OPAL_PARAMETER;
 
@@ -3988,6 +4270,32 @@ static int64_t opal_xive_set_queue_info(uint64_t vp, uint32_t prio,
 	} else
 		xive_cleanup_eq(&eq);
 
+	*out_x = x;
+	*out_blk = blk;
+	*out_idx = idx;
+	*out_eq = eq;
+
+	return OPAL_SUCCESS;
+}
+
+static int64_t opal_xive_set_queue_info(uint64_t vp, uint32_t prio,
+					uint64_t qpage,
+					uint64_t qsize,
+					uint64_t qflags)
+{
+	uint32_t blk, idx;
+	struct xive *x;
+	struct xive_eq eq;
+	int64_t rc;
+
+	if (xive_mode != XIVE_MODE_EXPL)
+		return OPAL_WRONG_STATE;
+
+	rc = xive_prepare_queue_info(vp, prio, qpage, qsize, qflags,
+				     &x, &blk, &idx, &eq);
+	if (rc)
+		return rc;
+
 	/* Update EQ, non-synchronous */
 	lock(&x->lock);
 	rc = xive_eqc_cache_update(x, blk, idx, &eq, false);
@@ -3996,6 +4304,63 @@ static int64_t opal_xive_set_queue_info(uint64_t vp, uint32_t prio,
 	return rc;
 }
 
+/*
+ * Configure several queues of a VP at once, queues[] is indexed by
+ * priority and prio_mask has a bit set for each priority to update.
+ * All the EQs are checked before any is updated and the updates are
+ * scrubbed once for the lot.
+ */
+static int64_t opal_xive_set_vp_queues(uint64_t vp,
+				       struct opal_xive_queue_config *queues,
+				       uint64_t prio_mask)
+{
+	struct xive_eq eqs[OPAL_XIVE_VP_QUEUES];
+	uint32_t blk[OPAL_XIVE_VP_QUEUES], idx[OPAL_XIVE_VP_QUEUES];
+	struct xive *x = NULL, *qx;
+	int64_t rc = OPAL_SUCCESS, rc2;
+	uint32_t prio;
+
+	if (xive_mode != XIVE_MODE_EXPL)
+		return OPAL_WRONG_STATE;
+	if (!prio_mask || prio_mask >= (1ul << OPAL_XIVE_VP_QUEUES) ||
+	    !opal_addr_valid(queues))
+		return OPAL_PARAMETER;
+
+	for (prio = 0; prio < OPAL_XIVE_VP_QUEUES; prio++) {
+		struct opal_xive_queue_config *q = &queues[prio];
+
+		if (!(prio_mask & (1ul << prio)))
+			continue;
+		rc = xive_prepare_queue_info(vp, prio, be64_to_cpu(q->qpage),
+					     be64_to_cpu(q->qsize),
+					     be64_to_cpu(q->qflags), &qx,
+					     &blk[prio], &idx[prio],
+					     &eqs[prio]);
+		if (rc)
+			return rc;
+		/* All the EQs of a VP sit on the same XIVE */
+		if (x && qx != x)
+			return OPAL_PARAMETER;
+		x = qx;
+	}
+
+	/* Update EQs, non-synchronous */
+	lock(&x->lock);
+	xive_cache_batch_start(x);
+	for (prio = 0; prio < OPAL_XIVE_VP_QUEUES; prio++) {
+		if (!(prio_mask & (1ul << prio)))
+			continue;
+		rc = xive_eqc_cache_update(x, blk[prio], idx[prio],
+					   &eqs[prio], false);
+		if (rc)
+			break;
+	}
+	rc2 = xive_cache_batch_end(x);
+	unlock(&x->lock);
+
+	return rc ? rc : rc2;
+}
+
 static int64_t opal_xive_get_queue_state(uint64_t vp, uint32_t prio,
 					 __be32 *out_qtoggle,
 					 __be32 *out_qindex)
@@ -4261,7 +4626,7 @@ static int64_t opal_xive_set_vp_info(uint64_t vp_id,
 	struct xive_vp *vp, vp_new;
 	uint32_t blk, idx;
 	bool group;
-	int64_t rc;
+	int64_t rc, rc2;
 
 	if (!xive_decode_vp(vp_id, &blk, &idx, NULL, &group))
 		return OPAL_PARAMETER;
@@ -4279,6 +4644,9 @@ static int64_t opal_xive_set_vp_info(uint64_t vp_id,
 
 	lock(&x->lock);
 
+	/* Scrub the EQ and VP updates once at the end */
+	xive_cache_batch_start(x);
+
 	vp_new = *vp;
 	if (flags & OPAL_XIVE_VP_ENABLED) {
 		vp_new.w0 = xive_set_field32(VP_W0_VALID, vp_new.w0, 1);
@@ -4301,16 +4669,18 @@ static int64_t opal_xive_set_vp_info(uint64_t vp_id,
 	}
 
 	rc = xive_vpc_cache_update(x, blk, idx, &vp_new, false);
-	if (rc)
-		goto bail;
+
+bail:
+	rc2 = xive_cache_batch_end(x);
+	if (!rc)
+		rc = rc2;
 
 	/* When disabling, we scrub clean (invalidate the entry) so
 	 * we can avoid cache ops in alloc/free
 	 */
-	if (!(flags & OPAL_XIVE_VP_ENABLED))
+	if (!rc && !(flags & OPAL_XIVE_VP_ENABLED))
 		xive_vpc_scrub_clean(x, blk, idx);
 
-bail:
 	unlock(&x->lock);
 	return rc;
 }
@@ -4481,6 +4851,9 @@ static void xive_reset_one(struct xive *x)
 
 	xive_dbg(x, "Resetting EQs...\n");
 
+	/* Scrub the EQ and VP updates below once at the end */
+	xive_cache_batch_start(x);
+
 	/* Reset all allocated EQs and free the user ones */
 	bitmap_for_each_one(*x->eq_map, XIVE_EQ_COUNT >> 3, i) {
 		struct xive_eq eq0;
@@ -4548,6 +4921,9 @@ static void xive_reset_one(struct xive *x)
 		xive_vpc_cache_update(x, x->block_id, i, &vp0, true);
 	}
 
+	/* Push it all out before the indirect pages go away */
+	xive_cache_batch_end(x);
+
 	/* Forget about remaining donated pages */
 	list_head_init(&x->donated_pages);
 
@@ -4635,6 +5011,7 @@ static int64_t __xive_reset(uint64_t version)
 	}
 
 	/* Cleanup global VP allocator */
+	xive_vp_pools_reset();
 	buddy_reset(xive_vp_buddy);
 
 	/* We reserve the whole range of VPs representing HW chips.
@@ -5229,8 +5606,10 @@ void init_xive(void)
 	opal_register(OPAL_XIVE_GET_IRQ_INFO, opal_xive_get_irq_info, 6);
 	opal_register(OPAL_XIVE_GET_IRQ_CONFIG, opal_xive_get_irq_config, 4);
 	opal_register(OPAL_XIVE_SET_IRQ_CONFIG, opal_xive_set_irq_config, 4);
+	opal_register(OPAL_XIVE_SET_IRQ_CONFIGS, opal_xive_set_irq_configs, 2);
 	opal_register(OPAL_XIVE_GET_QUEUE_INFO, opal_xive_get_queue_info, 7);
 	opal_register(OPAL_XIVE_SET_QUEUE_INFO, opal_xive_set_queue_info, 5);
+	opal_register(OPAL_XIVE_SET_VP_QUEUES, opal_xive_set_vp_queues, 3);
 	opal_register(OPAL_XIVE_DONATE_PAGE, opal_xive_donate_page, 2);
 	opal_register(OPAL_XIVE_ALLOCATE_IRQ, opal_xive_allocate_irq, 1);
 	opal_register(OPAL_XIVE_FREE_IRQ, opal_xive_free_irq, 1);
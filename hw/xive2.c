@@ -340,6 +340,14 @@ struct xive {
 
 	/* INT HW Errata */
 	uint64_t		quirks;
+
+	/* Cache watch updates done between xive_cache_batch_start() and
+	 * xive_cache_batch_end() are only scrubbed at the end, once per
+	 * cache and block. These are bitmaps of the blocks to scrub.
+	 */
+	bool			cache_batch;
+	uint32_t		cache_batch_end_blks;
+	uint32_t		cache_batch_nvp_blks;
 };
 
 /* First XIVE unit configured on the system */
@@ -467,6 +475,25 @@ static uint32_t xive_chips_alloc_bits = 0;
 static struct buddy *xive_vp_buddy;
 static struct lock xive_buddy_lock = LOCK_UNLOCKED;
 
+/* Per-chip VP pools.
+ *
+ * Freed VP blocks of the common small orders are parked in the pool
+ * of the chip that freed them and handed out again without going
+ * through the global buddy, trying the local chip first. The VP
+ * number encoding stripes every block across all chips, so a pooled
+ * block is still provisioned on all of them: the pools only shard
+ * the lock and keep guest start/stop churn out of the buddy.
+ */
+#define XIVE_VP_POOL_ORDERS	8
+#define XIVE_VP_POOL_DEPTH	8
+
+struct xive_vp_pool {
+	struct lock	lock;
+	uint32_t	count[XIVE_VP_POOL_ORDERS];
+	uint32_t	idx[XIVE_VP_POOL_ORDERS][XIVE_VP_POOL_DEPTH];
+};
+static struct xive_vp_pool xive_vp_pools[XIVE_MAX_CHIPS];
+
 /* VP# decoding/encoding */
 static bool xive_decode_vp(uint32_t vp, uint32_t *blk, uint32_t *idx,
 			   uint8_t *order, bool *group)
@@ -879,6 +906,8 @@ static bool xive_provision_vp_ind(struct xive *x, uint32_t vp_idx, uint32_t orde
 
 static void xive_init_vp_allocator(void)
 {
+	unsigned int i;
+
 	/* Initialize chip alloc bits */
 	xive_chips_alloc_bits = ilog2(xive_block_count);
 
@@ -898,6 +927,94 @@ static void xive_init_vp_allocator(void)
 	 */
 	assert(buddy_reserve(xive_vp_buddy, xive_hw_vp_base,
 			     xive_threadid_shift));
+
+	for (i = 0; i < XIVE_MAX_CHIPS; i++)
+		init_lock(&xive_vp_pools[i].lock);
+}
+
+static struct xive_vp_pool *xive_vp_local_pool(uint32_t *home)
+{
+	struct proc_chip *c = get_chip(this_cpu()->chip_id);
+
+	*home = (c && c->xive) ? c->xive->block_id : 0;
+	return &xive_vp_pools[*home];
+}
+
+static int xive_vp_pool_get(uint32_t local_order)
+{
+	struct xive_vp_pool *p;
+	uint32_t home, i;
+	int vp = -1;
+
+	if (local_order >= XIVE_VP_POOL_ORDERS)
+		return -1;
+
+	/* Local chip first, then steal from the others */
+	xive_vp_local_pool(&home);
+	for (i = 0; i < xive_block_count && vp < 0; i++) {
+		p = &xive_vp_pools[(home + i) % xive_block_count];
+
+		/* Unlocked peek, re-checked under the lock */
+		if (!p->count[local_order])
+			continue;
+		lock(&p->lock);
+		if (p->count[local_order])
+			vp = p->idx[local_order][--p->count[local_order]];
+		unlock(&p->lock);
+	}
+	return vp;
+}
+
+static bool xive_vp_pool_put(uint32_t idx, uint32_t local_order)
+{
+	struct xive_vp_pool *p;
+	uint32_t home;
+	bool pooled = false;
+
+	if (local_order >= XIVE_VP_POOL_ORDERS)
+		return false;
+
+	p = xive_vp_local_pool(&home);
+	lock(&p->lock);
+	if (p->count[local_order] < XIVE_VP_POOL_DEPTH) {
+		p->idx[local_order][p->count[local_order]++] = idx;
+		pooled = true;
+	}
+	unlock(&p->lock);
+	return pooled;
+}
+
+/* Give all pooled blocks back to the buddy so they can coalesce */
+static void xive_vp_pools_drain(void)
+{
+	struct xive_vp_pool *p;
+	uint32_t i, o;
+
+	for (i = 0; i < xive_block_count; i++) {
+		p = &xive_vp_pools[i];
+		lock(&p->lock);
+		lock(&xive_buddy_lock);
+		for (o = 0; o < XIVE_VP_POOL_ORDERS; o++) {
+			while (p->count[o])
+				buddy_free(xive_vp_buddy,
+					   p->idx[o][--p->count[o]], o);
+		}
+		unlock(&xive_buddy_lock);
+		unlock(&p->lock);
+	}
+}
+
+/* On reset the buddy is wiped, just forget about the pooled blocks */
+static void xive_vp_pools_reset(void)
+{
+	uint32_t i;
+
+	for (i = 0; i < xive_block_count; i++) {
+		lock(&xive_vp_pools[i].lock);
+		memset(xive_vp_pools[i].count, 0,
+		       sizeof(xive_vp_pools[i].count));
+		unlock(&xive_vp_pools[i].lock);
+	}
 }
 
 static uint32_t xive_alloc_vps(uint32_t order)
@@ -912,11 +1029,23 @@ static uint32_t xive_alloc_vps(uint32_t order)
 	/* We split the allocation */
 	local_order = order - xive_chips_alloc_bits;
 
+	/* Fast path: a pooled block, already provisioned everywhere */
+	vp = xive_vp_pool_get(local_order);
+	if (vp >= 0)
+		return xive_encode_vp(0, vp, order);
+
 	/* We grab that in the global buddy */
 	assert(xive_vp_buddy);
 	lock(&xive_buddy_lock);
 	vp = buddy_alloc(xive_vp_buddy, local_order);
 	unlock(&xive_buddy_lock);
+	if (vp < 0) {
+		/* The pools may be sitting on the buddies we need */
+		xive_vp_pools_drain();
+		lock(&xive_buddy_lock);
+		vp = buddy_alloc(xive_vp_buddy, local_order);
+		unlock(&xive_buddy_lock);
+	}
 	if (vp < 0)
 		return XIVE_ALLOC_NO_SPACE;
 
@@ -954,6 +1083,10 @@ static void xive_free_vps(uint32_t vp)
 	/* We split the allocation */
 	local_order = order - xive_chips_alloc_bits;
 
+	/* Keep it around for the next guest if the local pool has room */
+	if (xive_vp_pool_put(idx, local_order))
+		return;
+
 	/* Free that in the buddy */
 	lock(&xive_buddy_lock);
 	buddy_free(xive_vp_buddy, idx, local_order);
@@ -973,10 +1106,14 @@ enum xive_cache_type {
 
 #define FLUSH_CTRL_POLL_VALID PPC_BIT(0)  /* POLL bit is the same for all */
 
-static int64_t __xive_cache_scrub(struct xive *x,
-				  enum xive_cache_type ctype,
-				  uint64_t block, uint64_t idx,
-				  bool want_inval __unused, bool want_disable __unused)
+/*
+ * Scrub the entries matching idx under idx_mask, all ones to scrub a
+ * single entry and zero to scrub the whole block
+ */
+static int64_t __xive_cache_scrub_mask(struct xive *x,
+				       enum xive_cache_type ctype,
+				       uint64_t block, uint64_t idx,
+				       uint64_t idx_mask)
 {
 	uint64_t ctrl_reg, x_ctrl_reg;
 	uint64_t poll_val, ctrl_val;
@@ -990,7 +1127,7 @@ static int64_t __xive_cache_scrub(struct xive *x,
 			SETFIELD(VC_EASC_FLUSH_POLL_BLOCK_ID, 0ll, block) |
 			SETFIELD(VC_EASC_FLUSH_POLL_OFFSET, 0ll, idx) |
 			VC_EASC_FLUSH_POLL_BLOCK_ID_MASK |
-			VC_EASC_FLUSH_POLL_OFFSET_MASK;
+			SETFIELD(VC_EASC_FLUSH_POLL_OFFSET_MASK, 0ll, idx_mask);
 		xive_regw(x, VC_EASC_FLUSH_POLL, poll_val);
 		ctrl_reg = VC_EASC_FLUSH_CTRL;
 		x_ctrl_reg = X_VC_EASC_FLUSH_CTRL;
@@ -1000,7 +1137,7 @@ static int64_t __xive_cache_scrub(struct xive *x,
 			SETFIELD(VC_ESBC_FLUSH_POLL_BLOCK_ID, 0ll, block) |
 			SETFIELD(VC_ESBC_FLUSH_POLL_OFFSET, 0ll, idx) |
 			VC_ESBC_FLUSH_POLL_BLOCK_ID_MASK |
-			VC_ESBC_FLUSH_POLL_OFFSET_MASK;
+			SETFIELD(VC_ESBC_FLUSH_POLL_OFFSET_MASK, 0ll, idx_mask);
 		xive_regw(x, VC_ESBC_FLUSH_POLL, poll_val);
 		ctrl_reg = VC_ESBC_FLUSH_CTRL;
 		x_ctrl_reg = X_VC_ESBC_FLUSH_CTRL;
@@ -1010,7 +1147,7 @@ static int64_t __xive_cache_scrub(struct xive *x,
 			SETFIELD(VC_ENDC_FLUSH_POLL_BLOCK_ID, 0ll, block) |
 			SETFIELD(VC_ENDC_FLUSH_POLL_OFFSET, 0ll, idx) |
 			VC_ENDC_FLUSH_POLL_BLOCK_ID_MASK |
-			VC_ENDC_FLUSH_POLL_OFFSET_MASK;
+			SETFIELD(VC_ENDC_FLUSH_POLL_OFFSET_MASK, 0ll, idx_mask);
 		xive_regw(x, VC_ENDC_FLUSH_POLL, poll_val);
 		ctrl_reg = VC_ENDC_FLUSH_CTRL;
 		x_ctrl_reg = X_VC_ENDC_FLUSH_CTRL;
@@ -1020,7 +1157,7 @@ static int64_t __xive_cache_scrub(struct xive *x,
 			SETFIELD(PC_NXC_FLUSH_POLL_BLOCK_ID, 0ll, block) |
 			SETFIELD(PC_NXC_FLUSH_POLL_OFFSET, 0ll, idx) |
 			PC_NXC_FLUSH_POLL_BLOCK_ID_MASK |
-			PC_NXC_FLUSH_POLL_OFFSET_MASK;
+			SETFIELD(PC_NXC_FLUSH_POLL_OFFSET_MASK, 0ll, idx_mask);
 		xive_regw(x, PC_NXC_FLUSH_POLL, poll_val);
 		ctrl_reg = PC_NXC_FLUSH_CTRL;
 		x_ctrl_reg = X_PC_NXC_FLUSH_CTRL;
@@ -1041,6 +1178,14 @@ static int64_t __xive_cache_scrub(struct xive *x,
 	return 0;
 }
 
+static int64_t __xive_cache_scrub(struct xive *x,
+				  enum xive_cache_type ctype,
+				  uint64_t block, uint64_t idx,
+				  bool want_inval __unused, bool want_disable __unused)
+{
+	return __xive_cache_scrub_mask(x, ctype, block, idx, ~0ull);
+}
+
 static int64_t xive_easc_scrub(struct xive *x, uint64_t block, uint64_t idx)
 {
 	return __xive_cache_scrub(x, xive_cache_easc, block, idx, false, false);
@@ -1153,12 +1298,63 @@ static int64_t __xive_cache_watch(struct xive *x, enum xive_cache_type ctype,
 		}
 	}
 
+	/* In a batch, leave the scrub to xive_cache_batch_end() */
+	if (x->cache_batch) {
+		if (ctype == xive_cache_endc)
+			x->cache_batch_end_blks |= 1u << block;
+		else
+			x->cache_batch_nvp_blks |= 1u << block;
+		return 0;
+	}
+
 	/* Perform a scrub with "want_invalidate" set to false to push the
 	 * cache updates to memory as well
 	 */
 	return __xive_cache_scrub(x, ctype, block, idx, false, false);
 }
 
+/*
+ * Batched cache updates: between these two calls, cache watches only
+ * update the cache and the scrubs pushing the updates to memory are
+ * done at the end, one for each block of each cache. Nothing may rely
+ * on the in-memory END/NVP content before xive_cache_batch_end().
+ */
+static void xive_cache_batch_start(struct xive *x)
+{
+#ifdef XIVE_CHECK_LOCKS
+	assert(lock_held_by_me(&x->lock));
+#endif
+	assert(!x->cache_batch);
+	x->cache_batch = true;
+}
+
+static int64_t xive_cache_batch_end(struct xive *x)
+{
+	int64_t rc, ret = 0;
+	uint32_t blk;
+
+	x->cache_batch = false;
+
+	for (blk = 0; blk < 32; blk++) {
+		if (x->cache_batch_end_blks & (1u << blk)) {
+			rc = __xive_cache_scrub_mask(x, xive_cache_endc,
+						     blk, 0, 0);
+			if (rc && !ret)
+				ret = rc;
+		}
+		if (x->cache_batch_nvp_blks & (1u << blk)) {
+			rc = __xive_cache_scrub_mask(x, xive_cache_nxc,
+						     blk, 0, 0);
+			if (rc && !ret)
+				ret = rc;
+		}
+	}
+	x->cache_batch_end_blks = 0;
+	x->cache_batch_nvp_blks = 0;
+
+	return ret;
+}
+
 #ifdef XIVE_DEBUG_INIT_CACHE_UPDATES
 static bool xive_check_endc_update(struct xive *x, uint32_t idx, struct xive_end *end)
 {
@@ -2051,12 +2247,8 @@ static void late_init_one_xive(struct xive *x)
 
 static bool xive_check_ipi_free(struct xive *x, uint32_t irq, uint32_t count)
 {
-	uint32_t i, idx = GIRQ_TO_IDX(irq);
-
-	for (i = 0; i < count; i++)
-		if (bitmap_tst_bit(*x->ipi_alloc_map, idx + i))
-			return false;
-	return true;
+	return bitmap_find_one_bit(*x->ipi_alloc_map, GIRQ_TO_IDX(irq),
+				   count) < 0;
 }
 
 uint32_t xive2_alloc_hw_irqs(uint32_t chip_id, uint32_t count,
@@ -2548,9 +2740,34 @@ static int64_t xive_sync(struct xive *x __unused)
 	return 0;
 }
 
-static int64_t __xive_set_irq_config(struct irq_source *is, uint32_t girq,
-				     uint64_t vp, uint8_t prio, uint32_t lirq,
-				     bool update_esb, bool sync)
+/* XIVEs to sync once a set of interrupts has been reconfigured */
+struct xive_sync_set {
+	uint64_t	src_chips;
+	uint64_t	tgt_chips;
+};
+
+static void xive_sync_set_run(struct xive_sync_set *ss)
+{
+	struct proc_chip *chip;
+
+	/* Sources first, then the old targets, as for a single irq */
+	for_each_chip(chip)
+		if (chip->xive && (ss->src_chips & (1ull << chip->id)))
+			xive_sync(chip->xive);
+	for_each_chip(chip)
+		if (chip->xive && (ss->tgt_chips & (1ull << chip->id)))
+			xive_sync(chip->xive);
+}
+
+/*
+ * Reconfigure an interrupt and add the XIVEs that need a sync for it
+ * to the set, see __xive_set_irq_config()
+ */
+static int64_t xive_set_irq_config_deferred(struct irq_source *is,
+					    uint32_t girq, uint64_t vp,
+					    uint8_t prio, uint32_t lirq,
+					    bool update_esb,
+					    struct xive_sync_set *ss)
 {
 	struct xive_src *s = container_of(is, struct xive_src, is);
 	uint32_t old_target, vp_blk;
@@ -2589,18 +2806,33 @@ static int64_t __xive_set_irq_config(struct irq_source *is, uint32_t girq,
 	 * WARNING: This assumes the VP and it's queues are on the same
 	 *          XIVE instance !
 	 */
-	if (!sync)
-		return OPAL_SUCCESS;
-	xive_sync(s->xive);
+	ss->src_chips |= 1ull << s->xive->chip_id;
 	if (xive_decode_vp(old_target, &vp_blk, NULL, NULL, NULL)) {
 		struct xive *x = xive_from_pc_blk(vp_blk);
 		if (x)
-			xive_sync(x);
+			ss->tgt_chips |= 1ull << x->chip_id;
 	}
 
 	return OPAL_SUCCESS;
 }
 
+static int64_t __xive_set_irq_config(struct irq_source *is, uint32_t girq,
+				     uint64_t vp, uint8_t prio, uint32_t lirq,
+				     bool update_esb, bool sync)
+{
+	struct xive_sync_set ss = { 0, 0 };
+	int64_t rc;
+
+	rc = xive_set_irq_config_deferred(is, girq, vp, prio, lirq,
+					  update_esb, &ss);
+	if (rc || !sync)
+		return rc;
+
+	xive_sync_set_run(&ss);
+
+	return OPAL_SUCCESS;
+}
+
 static int64_t xive_set_irq_config(uint32_t girq, uint64_t vp, uint8_t prio,
 				   uint32_t lirq, bool update_esb)
 {
@@ -3249,6 +3481,48 @@ static int64_t opal_xive_set_irq_config(uint32_t girq,
 	return xive_set_irq_config(girq, vp, prio, lirq, false);
 }
 
+/*
+ * Vectored OPAL_XIVE_SET_IRQ_CONFIG: reconfigure up to
+ * OPAL_XIVE_IRQ_CONFIG_MAX interrupts, each with its own status, and
+ * sync each XIVE involved once at the end rather than once per
+ * interrupt.
+ */
+static int64_t opal_xive_set_irq_configs(struct opal_xive_irq_config *cfgs,
+					 uint64_t count)
+{
+	struct xive_sync_set ss = { 0, 0 };
+	uint64_t i;
+
+	if (xive_mode != XIVE_MODE_EXPL)
+		return OPAL_WRONG_STATE;
+	if (!count || count > OPAL_XIVE_IRQ_CONFIG_MAX ||
+	    !opal_addr_valid(cfgs))
+		return OPAL_PARAMETER;
+
+	for (i = 0; i < count; i++) {
+		struct opal_xive_irq_config *cfg = &cfgs[i];
+		uint32_t girq = be32_to_cpu(cfg->girq);
+		uint32_t prio = be32_to_cpu(cfg->prio);
+		struct irq_source *is = irq_find_source(girq);
+		int64_t rc;
+
+		/* Same as OPAL_XIVE_SET_IRQ_CONFIG, ESBs are left alone */
+		if (!is || prio > 0xff)
+			rc = OPAL_PARAMETER;
+		else
+			rc = xive_set_irq_config_deferred(is, girq,
+							  be64_to_cpu(cfg->vp),
+							  prio,
+							  be32_to_cpu(cfg->lirq),
+							  false, &ss);
+		cfg->status = cpu_to_be64(rc);
+	}
+
+	xive_sync_set_run(&ss);
+
+	return OPAL_SUCCESS;
+}
+
 static int64_t opal_xive_get_queue_info(uint64_t vp, uint32_t prio,
 					beint64_t *out_qpage,
 					beint64_t *out_qsize,
@@ -3340,10 +3614,15 @@ static void xive_cleanup_end(struct xive_end *end)
 	end->w2 = end->w3 = end->w4 = end->w5 = end->w6 = end->w7 = 0;
 }
 
-static int64_t opal_xive_set_queue_info(uint64_t vp, uint32_t prio,
-					uint64_t qpage,
-					uint64_t qsize,
-					uint64_t qflags)
+/*
+ * Build the new END for a queue configuration, which the caller then
+ * commits with the cache watch facility
+ */
+static int64_t xive_prepare_queue_info(uint64_t vp, uint32_t prio,
+				       uint64_t qpage, uint64_t qsize,
+				       uint64_t qflags, struct xive **out_x,
+				       uint32_t *out_blk, uint32_t *out_idx,
+				       struct xive_end *out_end)
 {
 	uint32_t blk, idx;
 	struct xive *x;
@@ -3351,7 +3630,6 @@ static int64_t opal_xive_set_queue_info(uint64_t vp, uint32_t prio,
 	struct xive_end end;
 	uint32_t vp_blk, vp_idx;
 	bool group;
-	int64_t rc;
 
 	if (!xive_end_for_target(vp, prio, &blk, &idx))
 		return OPAL_PARAMETER;
@@ -3436,6 +3714,29 @@ static int64_t opal_xive_set_queue_info(uint64_t vp, uint32_t prio,
 	} else
 		xive_cleanup_end(&end);
 
+	*out_x = x;
+	*out_blk = blk;
+	*out_idx = idx;
+	*out_end = end;
+
+	return OPAL_SUCCESS;
+}
+
+static int64_t opal_xive_set_queue_info(uint64_t vp, uint32_t prio,
+					uint64_t qpage,
+					uint64_t qsize,
+					uint64_t qflags)
+{
+	uint32_t blk, idx;
+	struct xive *x;
+	struct xive_end end;
+	int64_t rc;
+
+	rc = xive_prepare_queue_info(vp, prio, qpage, qsize, qflags,
+				     &x, &blk, &idx, &end);
+	if (rc)
+		return rc;
+
 	/* Update END, non-synchronous */
 	lock(&x->lock);
 	rc = xive_endc_cache_update(x, blk, idx, &end, false);
@@ -3444,6 +3745,61 @@ static int64_t opal_xive_set_queue_info(uint64_t vp, uint32_t prio,
 	return rc;
 }
 
+/*
+ * Configure several queues of a VP at once, queues[] is indexed by
+ * priority and prio_mask has a bit set for each priority to update.
+ * All the ENDs are checked before any is updated and the updates are
+ * scrubbed once for the lot.
+ */
+static int64_t opal_xive_set_vp_queues(uint64_t vp,
+				       struct opal_xive_queue_config *queues,
+				       uint64_t prio_mask)
+{
+	struct xive_end ends[OPAL_XIVE_VP_QUEUES];
+	uint32_t blk[OPAL_XIVE_VP_QUEUES], idx[OPAL_XIVE_VP_QUEUES];
+	struct xive *x = NULL, *qx;
+	int64_t rc = OPAL_SUCCESS, rc2;
+	uint32_t prio;
+
+	if (!prio_mask || prio_mask >= (1ul << OPAL_XIVE_VP_QUEUES) ||
+	    !opal_addr_valid(queues))
+		return OPAL_PARAMETER;
+
+	for (prio = 0; prio < OPAL_XIVE_VP_QUEUES; prio++) {
+		struct opal_xive_queue_config *q = &queues[prio];
+
+		if (!(prio_mask & (1ul << prio)))
+			continue;
+		rc = xive_prepare_queue_info(vp, prio, be64_to_cpu(q->qpage),
+					     be64_to_cpu(q->qsize),
+					     be64_to_cpu(q->qflags), &qx,
+					     &blk[prio], &idx[prio],
+					     &ends[prio]);
+		if (rc)
+			return rc;
+		/* All the ENDs of a VP sit on the same XIVE */
+		if (x && qx != x)
+			return OPAL_PARAMETER;
+		x = qx;
+	}
+
+	/* Update ENDs, non-synchronous */
+	lock(&x->lock);
+	xive_cache_batch_start(x);
+	for (prio = 0; prio < OPAL_XIVE_VP_QUEUES; prio++) {
+		if (!(prio_mask & (1ul << prio)))
+			continue;
+		rc = xive_endc_cache_update(x, blk[prio], idx[prio],
+					    &ends[prio], false);
+		if (rc)
+			break;
+	}
+	rc2 = xive_cache_batch_end(x);
+	unlock(&x->lock);
+
+	return rc ? rc : rc2;
+}
+
 static int64_t opal_xive_get_queue_state(uint64_t vp, uint32_t prio,
 					 beint32_t *out_qtoggle,
 					 beint32_t *out_qindex)
@@ -3744,7 +4100,7 @@ static int64_t opal_xive_set_vp_info(uint64_t vp_id,
 	struct xive_nvp *vp, vp_new;
 	uint32_t blk, idx;
 	bool group;
-	int64_t rc;
+	int64_t rc, rc2;
 
 	if (!xive_decode_vp(vp_id, &blk, &idx, NULL, &group))
 		return OPAL_PARAMETER;
@@ -3766,6 +4122,9 @@ static int64_t opal_xive_set_vp_info(uint64_t vp_id,
 
 	lock(&x->lock);
 
+	/* Scrub the END and NVP updates once at the end */
+	xive_cache_batch_start(x);
+
 	vp_new = *vp;
 	if (flags & OPAL_XIVE_VP_ENABLED) {
 		vp_new.w0 = xive_set_field32(NVP_W0_VALID, vp_new.w0, 1);
@@ -3811,16 +4170,18 @@ static int64_t opal_xive_set_vp_info(uint64_t vp_id,
 	}
 
 	rc = xive_nxc_cache_update(x, blk, idx, &vp_new, false);
-	if (rc)
-		goto bail;
+
+bail:
+	rc2 = xive_cache_batch_end(x);
+	if (!rc)
+		rc = rc2;
 
 	/* When disabling, we scrub clean (invalidate the entry) so
 	 * we can avoid cache ops in alloc/free
 	 */
-	if (!(flags & OPAL_XIVE_VP_ENABLED))
+	if (!rc && !(flags & OPAL_XIVE_VP_ENABLED))
 		xive_nxc_scrub_clean(x, blk, idx);
 
-bail:
 	unlock(&x->lock);
 	return rc;
 }
@@ -3980,6 +4341,9 @@ static void xive_reset_one(struct xive *x)
 
 	xive_dbg(x, "Resetting ENDs...\n");
 
+	/* Scrub the END and VP updates below once at the end */
+	xive_cache_batch_start(x);
+
 	/* Reset all allocated ENDs and free the user ones */
 	bitmap_for_each_one(*x->end_map, xive_end_bitmap_size(x), i) {
 		struct xive_end end0;
@@ -4047,6 +4411,9 @@ static void xive_reset_one(struct xive *x)
 		xive_nxc_cache_update(x, x->block_id, i, &vp0, true);
 	}
 
+	/* Push it all out before the indirect pages go away */
+	xive_cache_batch_end(x);
+
 	/* Forget about remaining donated pages */
 	list_head_init(&x->donated_pages);
 
@@ -4130,6 +4497,7 @@ static int64_t __xive_reset(uint64_t mode)
 	}
 
 	/* Cleanup global VP allocator */
+	xive_vp_pools_reset();
 	buddy_reset(xive_vp_buddy);
 
 	/*
@@ -4678,8 +5046,10 @@ void xive2_init(void)
 	opal_register(OPAL_XIVE_GET_IRQ_INFO, opal_xive_get_irq_info, 6);
 	opal_register(OPAL_XIVE_GET_IRQ_CONFIG, opal_xive_get_irq_config, 4);
 	opal_register(OPAL_XIVE_SET_IRQ_CONFIG, opal_xive_set_irq_config, 4);
+	opal_register(OPAL_XIVE_SET_IRQ_CONFIGS, opal_xive_set_irq_configs, 2);
 	opal_register(OPAL_XIVE_GET_QUEUE_INFO, opal_xive_get_queue_info, 7);
 	opal_register(OPAL_XIVE_SET_QUEUE_INFO, opal_xive_set_queue_info, 5);
+	opal_register(OPAL_XIVE_SET_VP_QUEUES, opal_xive_set_vp_queues, 3);
 	opal_register(OPAL_XIVE_DONATE_PAGE, opal_xive_donate_page, 2);
 	opal_register(OPAL_XIVE_ALLOCATE_IRQ, opal_xive_allocate_irq, 1);
 	opal_register(OPAL_XIVE_FREE_IRQ, opal_xive_free_irq, 1);
@@ -50,9 +50,52 @@ static struct {
  * We used to have a per-target lock. However due to errata HW822317
  * we can have issues on the issuer side if multiple threads try to
  * send XSCOMs simultaneously (HMER responses get mixed up), so just
- * use a global lock instead
+ * use a global lock instead.
+ *
+ * The erratum only affects P8 and P9, so on later chips xscom_init()
+ * switches to the per-chip lock in struct proc_chip, which stops the
+ * SCOM traffic of one socket (OCC, DTS, HMI, IMC...) from serialising
+ * against every other socket.
  */
 static struct lock xscom_lock = LOCK_UNLOCKED;
+static uint64_t xscom_lock_taken;
+static uint64_t xscom_lock_contended;
+static bool xscom_per_chip_lock;
+
+static struct lock *xscom_lock_target(uint32_t gcid)
+{
+	struct proc_chip *chip;
+
+	if (!xscom_per_chip_lock)
+		return &xscom_lock;
+
+	/* Callers check the chip exists, don't crash if one doesn't */
+	chip = get_chip(gcid);
+	return chip ? &chip->xscom_lock : &xscom_lock;
+}
+
+static struct lock *xscom_lock_get(uint32_t gcid)
+{
+	struct lock *l = xscom_lock_target(gcid);
+	uint64_t *taken = &xscom_lock_taken;
+	uint64_t *contended = &xscom_lock_contended;
+
+	if (l != &xscom_lock) {
+		struct proc_chip *chip = get_chip(gcid);
+
+		taken = &chip->xscom_lock_taken;
+		contended = &chip->xscom_lock_contended;
+	}
+
+	/* Count the acquisitions that had to wait, under the lock */
+	if (!try_lock(l)) {
+		lock(l);
+		(*contended)++;
+	}
+	(*taken)++;
+
+	return l;
+}
 
 static inline void *xscom_addr(uint32_t gcid, uint32_t pcb_addr)
 {
@@ -591,6 +634,7 @@ static uint32_t xscom_decode_chiplet(uint32_t partid, uint64_t *pcb_addr)
 	return gcid;
 }
 
+/* Only used on P8, which always has the global lock */
 void _xscom_lock(void)
 {
 	lock(&xscom_lock);
@@ -664,12 +708,182 @@ static int64_t scom_write(struct scom_controller *scom, uint32_t partid,
 	return rc;
 }
 
+/*
+ * Read cache for SCOMs whose value doesn't change after IPL (chip ID,
+ * BARs...). Only the addresses in the table for the running proc_gen
+ * are ever cached and only callers of xscom_read_cached() fill the
+ * cache. Writes from skiboot (including the host and PRD going through
+ * OPAL) invalidate the matching entry, anything else that may change a
+ * cached register must call xscom_cache_invalidate() itself.
+ *
+ * The cache of a chip is protected by the XSCOM lock of that chip.
+ */
+struct xscom_cache_range {
+	uint32_t	start;
+	uint32_t	end;		/* inclusive */
+};
+
+static const struct xscom_cache_range xscom_cache_ranges_p8[] = {
+	{ 0x000f000f, 0x000f000f },	/* CFAM chip ID */
+	{ 0x02013f00, 0x02013f07 },	/* PBA BARs and BAR masks */
+	{ 0, 0 }
+};
+
+static const struct xscom_cache_range xscom_cache_ranges_p9[] = {
+	{ 0x000f000f, 0x000f000f },	/* CFAM chip ID */
+	{ 0x05012b00, 0x05012b07 },	/* PBA BARs and BAR masks */
+	{ 0x0201108d, 0x0201108d },	/* NX MMIO BAR */
+	{ 0, 0 }
+};
+
+static const struct xscom_cache_range xscom_cache_ranges_p10[] = {
+	{ 0x000f000f, 0x000f000f },	/* CFAM chip ID */
+	{ 0x01010cda, 0x01010ce1 },	/* PBA BARs and BAR masks */
+	{ 0x0201108d, 0x0201108d },	/* NX MMIO BAR */
+	{ 0, 0 }
+};
+
+#define XSCOM_CACHE_ENTRIES	32
+
+struct xscom_cache_entry {
+	uint32_t	addr;
+	bool		valid;
+	uint64_t	val;
+};
+
+struct xscom_cache {
+	struct xscom_cache_entry	entries[XSCOM_CACHE_ENTRIES];
+	uint64_t			hits;
+	uint64_t			misses;
+};
+
+static const struct xscom_cache_range *xscom_cache_ranges(void)
+{
+	switch (proc_gen) {
+	case proc_gen_p8:
+		return xscom_cache_ranges_p8;
+	case proc_gen_p9:
+		return xscom_cache_ranges_p9;
+	case proc_gen_p10:
+	case proc_gen_p11:
+		return xscom_cache_ranges_p10;
+	default:
+		return NULL;
+	}
+}
+
+static bool xscom_cacheable(uint64_t pcb_addr)
+{
+	const struct xscom_cache_range *r = xscom_cache_ranges();
+
+	if (!r)
+		return false;
+
+	for (; r->end; r++)
+		if (pcb_addr >= r->start && pcb_addr <= r->end)
+			return true;
+
+	return false;
+}
+
+static struct xscom_cache *xscom_cache_get(uint32_t partid, uint64_t pcb_addr)
+{
+	struct proc_chip *chip;
+
+	/* Direct accesses to a chip only */
+	if ((partid >> 28) != 0 || !xscom_cacheable(pcb_addr))
+		return NULL;
+
+	chip = get_chip(partid);
+	return chip ? chip->xscom_cache : NULL;
+}
+
+static struct xscom_cache_entry *xscom_cache_entry(struct xscom_cache *cache,
+						   uint64_t pcb_addr)
+{
+	return &cache->entries[pcb_addr % XSCOM_CACHE_ENTRIES];
+}
+
+int xscom_read_cached(uint32_t partid, uint64_t pcb_addr, uint64_t *val)
+{
+	struct xscom_cache *cache = xscom_cache_get(partid, pcb_addr);
+	struct xscom_cache_entry *e;
+	struct lock *l;
+	int rc;
+
+	if (!cache)
+		return xscom_read(partid, pcb_addr, val);
+
+	l = xscom_lock_get(partid);
+
+	e = xscom_cache_entry(cache, pcb_addr);
+	if (e->valid && e->addr == pcb_addr) {
+		cache->hits++;
+		*val = e->val;
+		unlock(l);
+		return OPAL_SUCCESS;
+	}
+
+	cache->misses++;
+	rc = __xscom_read(partid, pcb_addr, val);
+	if (rc == OPAL_SUCCESS) {
+		e->addr = pcb_addr;
+		e->val = *val;
+		e->valid = true;
+	}
+
+	unlock(l);
+	return rc;
+}
+
+/* Called with the XSCOM lock held */
+static void __xscom_cache_invalidate(uint32_t partid, uint64_t pcb_addr)
+{
+	struct xscom_cache *cache = xscom_cache_get(partid, pcb_addr);
+	struct xscom_cache_entry *e;
+
+	if (!cache)
+		return;
+
+	e = xscom_cache_entry(cache, pcb_addr);
+	if (e->addr == pcb_addr)
+		e->valid = false;
+}
+
+void xscom_cache_invalidate(uint32_t partid, uint64_t pcb_addr)
+{
+	struct lock *l;
+
+	if (!xscom_cache_get(partid, pcb_addr))
+		return;
+
+	l = xscom_lock_get(partid);
+	__xscom_cache_invalidate(partid, pcb_addr);
+	unlock(l);
+}
+
+void xscom_cache_flush(uint32_t partid)
+{
+	struct proc_chip *chip = get_chip(partid);
+	struct lock *l;
+	unsigned int i;
+
+	if (!chip || !chip->xscom_cache)
+		return;
+
+	l = xscom_lock_get(partid);
+	for (i = 0; i < XSCOM_CACHE_ENTRIES; i++)
+		chip->xscom_cache->entries[i].valid = false;
+	unlock(l);
+}
+
 /*
  * External API
  */
 int _xscom_read(uint32_t partid, uint64_t pcb_addr, uint64_t *val, bool take_lock)
 {
 	struct scom_controller *scom;
+	struct lock *l = NULL;
 	uint32_t gcid;
 	int rc;
 
@@ -710,9 +924,15 @@ int _xscom_read(uint32_t partid, uint64_t pcb_addr, uint64_t *val, bool take_loc
 		return OPAL_PARAMETER;
 	}
 
-	/* HW822317 requires us to do global locking */
+	/* Check the chip exists before we go for its lock */
+	if (!xscom_gcid_ok(gcid)) {
+		prerror("%s: invalid XSCOM gcid 0x%x\n", __func__, gcid);
+		return OPAL_PARAMETER;
+	}
+
+	/* HW822317 may require us to do global locking */
 	if (take_lock)
-		lock(&xscom_lock);
+		l = xscom_lock_get(gcid);
 
 	/* Direct vs indirect access */
 	if (pcb_addr & XSCOM_ADDR_IND_FLAG)
@@ -722,7 +942,7 @@ int _xscom_read(uint32_t partid, uint64_t pcb_addr, uint64_t *val, bool take_loc
 
 	/* Unlock it */
 	if (take_lock)
-		unlock(&xscom_lock);
+		unlock(l);
 	return rc;
 }
 
@@ -741,6 +961,7 @@ opal_call(OPAL_XSCOM_READ, opal_xscom_read, 3);
 int _xscom_write(uint32_t partid, uint64_t pcb_addr, uint64_t val, bool take_lock)
 {
 	struct scom_controller *scom;
+	struct lock *l = NULL;
 	uint32_t gcid;
 	int rc;
 
@@ -769,9 +990,15 @@ int _xscom_write(uint32_t partid, uint64_t pcb_addr, uint64_t val, bool take_loc
 		return OPAL_PARAMETER;
 	}
 
-	/* HW822317 requires us to do global locking */
+	/* Check the chip exists before we go for its lock */
+	if (!xscom_gcid_ok(gcid)) {
+		prerror("%s: invalid XSCOM gcid 0x%x\n", __func__, gcid);
+		return OPAL_PARAMETER;
+	}
+
+	/* HW822317 may require us to do global locking */
 	if (take_lock)
-		lock(&xscom_lock);
+		l = xscom_lock_get(gcid);
 
 	/* Direct vs indirect access */
 	if (pcb_addr & XSCOM_ADDR_IND_FLAG)
@@ -779,9 +1006,13 @@ int _xscom_write(uint32_t partid, uint64_t pcb_addr, uint64_t val, bool take_loc
 	else
 		rc = __xscom_write(gcid, pcb_addr & 0x7fffffff, val);
 
+	/* Whatever happened, the value we may have cached is stale */
+	if ((partid >> 28) == 0)
+		__xscom_cache_invalidate(partid, pcb_addr);
+
 	/* Unlock it */
 	if (take_lock)
-		unlock(&xscom_lock);
+		unlock(l);
 	return rc;
 }
 
@@ -791,6 +1022,100 @@ static int64_t opal_xscom_write(uint32_t partid, uint64_t pcb_addr, uint64_t val
 }
 opal_call(OPAL_XSCOM_WRITE, opal_xscom_write, 3);
 
+/*
+ * Batched access: run a list of XSCOMs for one OPAL entry and a single
+ * acquisition of the XSCOM lock. Chip and EX chiplet targets are
+ * accessed with the lock held across consecutive entries (for the same
+ * chip when locking per chip). The lock is dropped around
+ * scom_controller targets as those backends (Centaur etc.) issue
+ * XSCOMs of their own.
+ */
+static bool xscom_partid_is_chip(uint32_t partid)
+{
+	return (partid >> 28) == 0 || (partid >> 28) == 4;
+}
+
+/* The chip a chip or EX chiplet partid targets, see xscom_decode_chiplet */
+static uint32_t xscom_partid_gcid(uint32_t partid)
+{
+	if ((partid >> 28) == 4)
+		return (partid & 0x0fffffff) >> 4;
+	return partid;
+}
+
+static int64_t xscom_batch_one(struct opal_xscom_batch_op *op,
+			       bool take_lock)
+{
+	uint32_t partid = be32_to_cpu(op->partid);
+	uint64_t addr = be64_to_cpu(op->addr);
+	uint64_t val = be64_to_cpu(op->value);
+	uint64_t mask, old_val;
+	int64_t rc;
+
+	switch (be32_to_cpu(op->op)) {
+	case OPAL_XSCOM_BATCH_READ:
+		rc = _xscom_read(partid, addr, &val, take_lock);
+		op->value = cpu_to_be64(val);
+		break;
+	case OPAL_XSCOM_BATCH_WRITE:
+		rc = _xscom_write(partid, addr, val, take_lock);
+		break;
+	case OPAL_XSCOM_BATCH_WRITE_MASK:
+		mask = be64_to_cpu(op->mask);
+		rc = _xscom_read(partid, addr, &old_val, take_lock);
+		if (rc)
+			break;
+		val = (old_val & ~mask) | (val & mask);
+		rc = _xscom_write(partid, addr, val, take_lock);
+		break;
+	default:
+		rc = OPAL_PARAMETER;
+	}
+
+	return rc;
+}
+
+static int64_t opal_xscom_batch(struct opal_xscom_batch_op *ops,
+				uint64_t count)
+{
+	struct lock *locked = NULL;
+	uint64_t i;
+
+	if (!count || count > OPAL_XSCOM_BATCH_MAX || !opal_addr_valid(ops))
+		return OPAL_PARAMETER;
+
+	for (i = 0; i < count; i++) {
+		struct opal_xscom_batch_op *op = &ops[i];
+		uint32_t partid = be32_to_cpu(op->partid);
+		bool chip = xscom_partid_is_chip(partid);
+		struct lock *l = NULL;
+		int64_t rc;
+
+		if (chip && !xscom_gcid_ok(xscom_partid_gcid(partid))) {
+			op->status = cpu_to_be64(OPAL_PARAMETER);
+			continue;
+		}
+		if (chip)
+			l = xscom_lock_target(xscom_partid_gcid(partid));
+
+		if (locked && locked != l) {
+			unlock(locked);
+			locked = NULL;
+		}
+		if (!locked && l)
+			locked = xscom_lock_get(xscom_partid_gcid(partid));
+
+		rc = xscom_batch_one(op, !chip);
+		op->status = cpu_to_be64(rc);
+	}
+
+	if (locked)
+		unlock(locked);
+
+	return OPAL_SUCCESS;
+}
+opal_call(OPAL_XSCOM_BATCH, opal_xscom_batch, 2);
+
 /*
  * Perform a xscom read-modify-write.
  */
@@ -832,7 +1157,7 @@ int64_t xscom_read_cfam_chipid(uint32_t partid, uint32_t *chip_id)
 		else
 			val = 0x221EF04980000000UL; /* P8 Murano DD2.1 */
 	} else
-		rc = xscom_read(partid, 0xf000f, &val);
+		rc = xscom_read_cached(partid, 0xf000f, &val);
 
 	/* Extract CFAM id */
 	if (rc == OPAL_SUCCESS)
@@ -985,10 +1310,28 @@ int64_t xscom_trigger_xstop(void)
 	return rc;
 }
 
+/*
+ * HW822317 isn't fixed in any P8 or P9 revision, so this is down to
+ * the chip type rather than the EC level for now.
+ */
+static bool xscom_chip_has_hw822317(struct proc_chip *chip)
+{
+	switch (chip->type) {
+	case PROC_CHIP_P10:
+	case PROC_CHIP_P11:
+		return false;
+	case PROC_CHIP_UNKNOWN:
+		return proc_gen < proc_gen_p10;
+	default:
+		return true;
+	}
+}
+
 void xscom_init(void)
 {
 	struct dt_node *xn;
 	const struct dt_property *p;
+	bool per_chip_lock = true;
 
 	dt_for_each_compatible(dt_root, xn, "ibm,xscom") {
 		uint32_t gcid = dt_get_chip_id(xn);
@@ -1010,9 +1353,14 @@ void xscom_init(void)
 		assert(reg);
 
 		chip->xscom_base = dt_translate_address(xn, 0, NULL);
+		init_lock(&chip->xscom_lock);
+		chip->xscom_cache = zalloc(sizeof(struct xscom_cache));
+		assert(chip->xscom_cache);
 
 		/* Grab processor type and EC level */
 		xscom_init_chip_info(chip);
+		if (xscom_chip_has_hw822317(chip))
+			per_chip_lock = false;
 
 		if (chip->type >= ARRAY_SIZE(chip_names))
 			chip_name = "INVALID";
@@ -1026,6 +1374,11 @@ void xscom_init(void)
 		prlog(PR_DEBUG, "XSCOM: Base address: 0x%llx\n", chip->xscom_base);
 	}
 
+	/* Nothing else is issuing XSCOMs yet, so we can switch here */
+	xscom_per_chip_lock = per_chip_lock;
+	prlog(PR_DEBUG, "XSCOM: Using %s lock\n",
+	      per_chip_lock ? "per-chip" : "global");
+
 	/* Collect details to trigger xstop via XSCOM write */
 	p = dt_find_property(dt_root, "ibm,sw-checkstop-fir");
 	if (p) {
@@ -1039,6 +1392,8 @@ void xscom_init(void)
 
 void xscom_used_by_console(void)
 {
+	struct proc_chip *chip;
+
 	xscom_lock.in_con_path = true;
 
 	/*
@@ -1048,9 +1403,51 @@ void xscom_used_by_console(void)
 	 */
 	lock(&xscom_lock);
 	unlock(&xscom_lock);
+
+	if (!xscom_per_chip_lock)
+		return;
+
+	for_each_chip(chip) {
+		chip->xscom_lock.in_con_path = true;
+		lock(&chip->xscom_lock);
+		unlock(&chip->xscom_lock);
+	}
 }
 
 bool xscom_ok(void)
 {
-	return !lock_held_by_me(&xscom_lock);
+	struct proc_chip *chip;
+
+	if (lock_held_by_me(&xscom_lock))
+		return false;
+
+	if (xscom_per_chip_lock) {
+		for_each_chip(chip)
+			if (lock_held_by_me(&chip->xscom_lock))
+				return false;
+	}
+
+	return true;
+}
+
+void xscom_dump_stats(void)
+{
+	struct proc_chip *chip;
+
+	if (!xscom_per_chip_lock)
+		prlog(PR_INFO, "XSCOM: global lock taken %llu times, "
+		      "%llu contended\n", xscom_lock_taken, xscom_lock_contended);
+
+	for_each_chip(chip) {
+		if (xscom_per_chip_lock)
+			prlog(PR_INFO, "XSCOM: chip %x lock taken %llu times, "
+			      "%llu contended\n", chip->id,
+			      chip->xscom_lock_taken,
+			      chip->xscom_lock_contended);
+		if (chip->xscom_cache)
+			prlog(PR_INFO, "XSCOM: chip %x read cache %llu hits, "
+			      "%llu misses\n", chip->id,
+			      chip->xscom_cache->hits,
+			      chip->xscom_cache->misses);
+	}
 }
@@ -29,6 +29,12 @@ struct buddy {
 	 * have there to speed up searches.
 	 */
 	unsigned int freecounts[BUDDY_MAX_ORDER + 1];
+
+	/* Summary of the map: one bit per word of the map, set if
+	 * that word has at least one free node in it, so that a search
+	 * can skip a whole word of fully allocated words at once.
+	 */
+	bitmap_elem_t	*summary;
 	bitmap_elem_t     map[];
 };
 
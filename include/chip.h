@@ -161,6 +161,7 @@ struct lpcm;
 struct vas;
 struct p9_sbe;
 struct p9_dio;
+struct xscom_cache;
 
 /* Chip type */
 enum proc_chip_type {
@@ -231,6 +232,10 @@ struct proc_chip {
 
 	/* Used by hw/xscom.c */
 	uint64_t		xscom_base;
+	struct lock		xscom_lock;	/* Unless HW822317 applies */
+	uint64_t		xscom_lock_taken;
+	uint64_t		xscom_lock_contended;
+	struct xscom_cache	*xscom_cache;
 
 	/* Used by hw/lpc.c */
 	struct lpcm		*lpc;
@@ -59,9 +59,10 @@ static inline void set_last_phandle(u32 phandle)
 	last_phandle = phandle;
 }
 
+/* Nodes can be created from several CPUs at once, see pci_add_nodes() */
 static inline u32 new_phandle(void)
 {
-	return ++last_phandle;
+	return __atomic_add_fetch(&last_phandle, 1, __ATOMIC_RELAXED);
 }
 
 /* Add a child node. */
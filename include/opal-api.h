@@ -227,7 +227,12 @@
 #define OPAL_SECVAR_ENQUEUE_UPDATE		178
 #define OPAL_PHB_SET_OPTION			179
 #define OPAL_PHB_GET_OPTION			180
-#define OPAL_LAST				180
+#define OPAL_XSCOM_BATCH			181
+#define OPAL_XIVE_SET_VP_QUEUES			182
+#define OPAL_XIVE_SET_IRQ_CONFIGS		183
+#define OPAL_PCI_CONFIG_BATCH			184
+#define OPAL_PCI_SET_PES			185
+#define OPAL_LAST				185
 
 #define QUIESCE_HOLD			1 /* Spin all calls at entry */
 #define QUIESCE_REJECT			2 /* Fail all calls with OPAL_BUSY */
@@ -1130,6 +1135,22 @@ struct opal_i2c_request {
 	__be64 buffer_ra;		/* Buffer real address */
 };
 
+/* OPAL_XSCOM_BATCH descriptor, status is filled in for every entry */
+struct opal_xscom_batch_op {
+	__be32	partid;
+	__be32	op;
+#define OPAL_XSCOM_BATCH_READ		0
+#define OPAL_XSCOM_BATCH_WRITE		1
+#define OPAL_XSCOM_BATCH_WRITE_MASK	2
+	__be64	addr;
+	__be64	value;			/* Written, or read back */
+	__be64	mask;			/* Bits of value to write for WRITE_MASK */
+	__be64	status;			/* OPAL_* result of this access */
+};
+
+/* Max number of descriptors in one OPAL_XSCOM_BATCH call */
+#define OPAL_XSCOM_BATCH_MAX		256
+
 /* Argument to OPAL_CEC_REBOOT2() */
 enum {
 	OPAL_REBOOT_NORMAL = 0,
@@ -1139,6 +1160,43 @@ enum {
 	OPAL_REBOOT_FAST,
 };
 
+/* OPAL_PCI_CONFIG_BATCH descriptor, status is filled in for every entry */
+struct opal_pci_cfg_op {
+	__be16	bdfn;
+	uint8_t	op;
+#define OPAL_PCI_CFG_BATCH_READ		0
+#define OPAL_PCI_CFG_BATCH_WRITE	1
+	uint8_t	size;			/* 1, 2 or 4 bytes */
+	__be32	offset;
+	__be32	value;			/* Written, or read back */
+	__be32	reserved;
+	__be64	status;			/* OPAL_* result of this access */
+};
+
+/* Max number of descriptors in one OPAL_PCI_CONFIG_BATCH call */
+#define OPAL_PCI_CONFIG_BATCH_MAX	64
+
+/*
+ * OPAL_PCI_SET_PES descriptor, one PE configuration call each. The
+ * args are those of the equivalent single call, in order, after the
+ * PE number. status is filled in for every entry.
+ */
+struct opal_pci_pe_op {
+	__be32	op;
+#define OPAL_PCI_PE_OP_SET_PE		0 /* OPAL_PCI_SET_PE */
+#define OPAL_PCI_PE_OP_SET_PELTV	1 /* OPAL_PCI_SET_PELTV, PE is the child */
+#define OPAL_PCI_PE_OP_MAP_MMIO		2 /* OPAL_PCI_MAP_PE_MMIO_WINDOW */
+#define OPAL_PCI_PE_OP_MAP_DMA		3 /* OPAL_PCI_MAP_PE_DMA_WINDOW */
+#define OPAL_PCI_PE_OP_MAP_DMA_REAL	4 /* OPAL_PCI_MAP_PE_DMA_WINDOW_REAL */
+#define OPAL_PCI_PE_OP_SET_XIVE		5 /* OPAL_PCI_SET_XIVE_PE */
+	__be32	pe_number;
+	__be64	args[5];
+	__be64	status;			/* OPAL_* result of this call */
+};
+
+/* Max number of descriptors in one OPAL_PCI_SET_PES call */
+#define OPAL_PCI_SET_PES_MAX		256
+
 /* Argument to OPAL_PCI_TCE_KILL */
 enum {
 	OPAL_PCI_TCE_KILL_PAGES,
@@ -1173,6 +1231,29 @@ enum {
 	OPAL_XIVE_EQ_ESCALATE		= 0x00000004,
 };
 
+/* One queue of OPAL_XIVE_SET_VP_QUEUES, see OPAL_XIVE_SET_QUEUE_INFO */
+struct opal_xive_queue_config {
+	__be64	qpage;
+	__be64	qsize;
+	__be64	qflags;
+};
+
+/* Number of priorities, and queues, of a VP */
+#define OPAL_XIVE_VP_QUEUES		8
+
+/* One interrupt of OPAL_XIVE_SET_IRQ_CONFIGS, see OPAL_XIVE_SET_IRQ_CONFIG */
+struct opal_xive_irq_config {
+	__be64	vp;
+	__be32	girq;
+	__be32	lirq;
+	__be32	prio;			/* 0xff masks the interrupt */
+	__be32	reserved;
+	__be64	status;			/* OPAL_* result for this interrupt */
+};
+
+/* Max number of interrupts in one OPAL_XIVE_SET_IRQ_CONFIGS call */
+#define OPAL_XIVE_IRQ_CONFIG_MAX	256
+
 /* Flags for OPAL_XIVE_GET/SET_VP_INFO */
 enum {
 	OPAL_XIVE_VP_ENABLED		= 0x00000001,
@@ -51,6 +51,47 @@ struct pci_cfg_reg_filter {
 	struct list_node	link;
 };
 
+/*
+ * The filters of a device sorted by start offset, so that config
+ * accesses can look them up with a binary search rather than walking
+ * the list. A new table is built and published each time a filter is
+ * added, readers don't take any lock. Each entry remembers when its
+ * filter was added, where filters overlap the oldest one wins.
+ */
+struct pci_cfg_filter_ent {
+	struct pci_cfg_reg_filter	*pcrf;
+	uint32_t			seq;
+};
+
+struct pci_cfg_filter_table {
+	uint32_t			nr;
+	uint32_t			max_len;
+	struct pci_cfg_filter_ent	ents[];
+};
+
+extern bool pci_cfg_filter_table_add(struct pci_cfg_filter_table **table,
+				     struct pci_cfg_reg_filter *pcrf);
+extern int pci_cfg_filter_table_search(const struct pci_cfg_filter_table *t,
+				       uint32_t offset);
+
+/*
+ * Snapshot of the read-only parts of a device config space, taken
+ * while it's enumerated so that each capability list is walked at
+ * most once. It's freed once the device node has been created, or
+ * earlier if one of the registers it holds is written.
+ */
+#define PCI_CFG_CACHE_CAPS	0x20
+#define PCI_CFG_CACHE_ECAPS	0x40
+
+struct pci_cfg_cache {
+	uint32_t		rev_class;
+	bool			caps_walked;
+	bool			ecaps_walked;
+	uint8_t			cap_pos[PCI_CFG_CACHE_CAPS];
+	uint16_t		ecap_pos[PCI_CFG_CACHE_ECAPS];
+	uint8_t			ecap_ver[PCI_CFG_CACHE_ECAPS];
+};
+
 /*
  * While this might not be necessary in the long run, the existing
  * Linux kernels expect us to provide a device-tree that contains
@@ -81,6 +122,11 @@ struct pci_device {
 	uint8_t			subordinate_bus;
 	uint32_t		scan_map;
 
+	/* Bridge bring-up state while its bus is scanned */
+	uint8_t			link_state;
+	bool			link_was_reset;
+	uint64_t		link_ready_tb;
+
 	uint32_t		vdid;
 	uint32_t		sub_vdid;
 #define PCI_VENDOR_ID(x)	((x) & 0xFFFF)
@@ -94,9 +140,13 @@ struct pci_device {
 	} cap[64];
 	uint32_t		mps;		/* Max payload size capability */
 
+	struct pci_cfg_cache	*cfg_cache;
+	uint32_t		cfg_reads;	/* Issued to enumerate it */
+
 	uint32_t		pcrf_start;
 	uint32_t		pcrf_end;
 	struct list_head	pcrf;
+	struct pci_cfg_filter_table *pcrf_table;
 
 	/*
 	 * Relaxed ordering is a feature which allows PCIe devices accessing GPU
@@ -299,6 +349,14 @@ struct phb_ops {
 	int64_t (*set_xive_pe)(struct phb *phb, uint64_t pe_number,
 			       uint32_t xive_num);
 
+	/*
+	 * Optional, bracket a batch of the PE configuration calls above
+	 * so the backend can defer its cache invalidations and table
+	 * writes to the end of the batch.
+	 */
+	void (*pe_batch_start)(struct phb *phb);
+	void (*pe_batch_end)(struct phb *phb);
+
 	int64_t (*get_msi_32)(struct phb *phb, uint64_t mve_number,
 			      uint32_t xive_num, uint8_t msi_range,
 			      uint32_t *msi_address, uint32_t *message_data);
@@ -368,6 +426,15 @@ struct phb {
 	uint32_t		mps;
 	bitmap_t		*filter_map;
 
+	/* bdfn to device lookup, one table of 256 devfns per bus that
+	 * is allocated when the first device shows up on that bus.
+	 */
+	struct pci_device	**dev_index[256];
+
+	/* Number of config caches alive and config reads issued */
+	uint32_t		cfg_caches;
+	uint32_t		cfg_reads;
+
 	/* PCI-X only slot info, for PCI-E this is in the RC bridge */
 	struct pci_slot		*slot;
 
@@ -396,39 +463,51 @@ static inline void phb_unlock(struct phb *phb)
 bool pci_check_clear_freeze(struct phb *phb);
 
 /* Config space ops wrappers */
+extern void pci_cfg_cache_write(struct phb *phb, uint16_t bdfn,
+				uint32_t offset);
+
 static inline int64_t pci_cfg_read8(struct phb *phb, uint32_t bdfn,
 				    uint32_t offset, uint8_t *data)
 {
+	phb->cfg_reads++;
 	return phb->ops->cfg_read8(phb, bdfn, offset, data);
 }
 
 static inline int64_t pci_cfg_read16(struct phb *phb, uint32_t bdfn,
 				     uint32_t offset, uint16_t *data)
 {
+	phb->cfg_reads++;
 	return phb->ops->cfg_read16(phb, bdfn, offset, data);
 }
 
 static inline int64_t pci_cfg_read32(struct phb *phb, uint32_t bdfn,
 				     uint32_t offset, uint32_t *data)
 {
+	phb->cfg_reads++;
 	return phb->ops->cfg_read32(phb, bdfn, offset, data);
 }
 
 static inline int64_t pci_cfg_write8(struct phb *phb, uint32_t bdfn,
 				     uint32_t offset, uint8_t data)
 {
+	if (phb->cfg_caches)
+		pci_cfg_cache_write(phb, bdfn, offset);
 	return phb->ops->cfg_write8(phb, bdfn, offset, data);
 }
 
 static inline int64_t pci_cfg_write16(struct phb *phb, uint32_t bdfn,
 				      uint32_t offset, uint16_t data)
 {
+	if (phb->cfg_caches)
+		pci_cfg_cache_write(phb, bdfn, offset);
 	return phb->ops->cfg_write16(phb, bdfn, offset, data);
 }
 
 static inline int64_t pci_cfg_write32(struct phb *phb, uint32_t bdfn,
 				      uint32_t offset, uint32_t data)
 {
+	if (phb->cfg_caches)
+		pci_cfg_cache_write(phb, bdfn, offset);
 	return phb->ops->cfg_write32(phb, bdfn, offset, data);
 }
 
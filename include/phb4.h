@@ -5,6 +5,7 @@
 #define __PHB4_H
 
 #include <interrupts.h>
+#include <bitmap.h>
 
 /*
  * Memory map
@@ -152,6 +153,10 @@ struct phb4_err {
 #define PHB4_CAPP_RECOVERY	0x00000008
 #define PHB4_CAPP_DISABLE	0x00000010
 #define PHB4_ETU_IN_RESET	0x00000020
+#define PHB4_TCE_KILL_RANGE	0x00000040 /* Page kills are reliable */
+
+/* Above that many pages, a range kill becomes a PE kill */
+#define PHB4_TCE_KILL_PAGES_MAX	256
 
 struct phb4 {
 	unsigned int		index;	    /* 0..5 index inside p9/p10 */
@@ -216,6 +221,21 @@ struct phb4 {
 	/* Cache some RC registers that need to be emulated */
 	uint32_t		rc_cache[4];
 
+	/* TCE kills issued, indexed by OPAL_PCI_TCE_KILL_* */
+	uint64_t		tce_kills[3];
+	uint64_t		tce_kill_pages;
+
+	/*
+	 * While a batch of PE setup calls runs, the caches above act as
+	 * shadow tables: updated entries are marked dirty and written
+	 * back by phb4_ioda_flush() at the end of the batch.
+	 */
+	bool			pe_batch;
+	bool			rtc_dirty;
+	uint8_t			mist_dirty[4096/4]; /* PWV bits per MIST entry */
+	bitmap_elem_t		tve_dirty[BITMAP_ELEMS(1024)];
+	uint64_t		ioda_mmios; /* IODA select and data accesses */
+
 	/* Current NPU2 relaxed ordering state */
 	bool			ro_state;
 
@@ -269,10 +269,22 @@ static inline int xscom_write(uint32_t partid, uint64_t pcb_addr, uint64_t val)
 }
 extern int xscom_write_mask(uint32_t partid, uint64_t pcb_addr, uint64_t val, uint64_t mask);
 
+/*
+ * Cached SCOM reads, for registers that don't change after IPL. Only
+ * a fixed set of addresses per processor generation is cached, reads
+ * of anything else go straight to xscom_read(). Writes through
+ * xscom_write() invalidate the cache, changes made behind skiboot's
+ * back need an explicit invalidate.
+ */
+extern int xscom_read_cached(uint32_t partid, uint64_t pcb_addr, uint64_t *val);
+extern void xscom_cache_invalidate(uint32_t partid, uint64_t pcb_addr);
+extern void xscom_cache_flush(uint32_t partid);
+
 /* This chip SCOM access */
 extern int xscom_readme(uint64_t pcb_addr, uint64_t *val);
 extern int xscom_writeme(uint64_t pcb_addr, uint64_t val);
 extern void xscom_init(void);
+extern void xscom_dump_stats(void);
 
 /* Mark XSCOM lock as being in console path */
 extern void xscom_used_by_console(void);
@@ -504,6 +504,46 @@ out:
 	return rc;
 }
 
+/*
+ * A run of contiguous erase blocks in the middle of a smart write that
+ * are all entirely replaced by the new data. The blocks that need
+ * erasing are erased with one call (along with any write-only blocks
+ * between them, they are about to be rewritten anyway) and the whole
+ * run is written straight from the caller's buffer, rather than erase
+ * block by erase block.
+ */
+struct smart_run {
+	uint64_t pos;
+	uint64_t len;
+	const void *buf;
+	uint64_t erase_pos;
+	uint64_t erase_len;
+};
+
+static int smart_run_flush(struct blocklevel_device *bl, struct smart_run *run)
+{
+	int rc;
+
+	if (!run->len)
+		return 0;
+
+	if (run->erase_len) {
+		FL_DBG("%s: erase 0x%" PRIx64 "..0x%" PRIx64 "\n", __func__,
+				run->erase_pos, run->erase_pos + run->erase_len);
+		rc = bl->erase(bl, run->erase_pos, run->erase_len);
+		run->erase_len = 0;
+		if (rc)
+			goto out;
+	}
+
+	FL_DBG("%s: write 0x%" PRIx64 "..0x%" PRIx64 "\n", __func__,
+			run->pos, run->pos + run->len);
+	rc = bl->write(bl, run->pos, run->buf, run->len);
+out:
+	run->len = 0;
+	return rc;
+}
+
 int blocklevel_smart_write(struct blocklevel_device *bl, uint64_t pos, const void *buf, uint64_t len)
 {
 	void *ecc_buf = NULL;
@@ -517,6 +557,8 @@ int blocklevel_smart_write(struct blocklevel_device *bl, uint64_t pos, const voi
 	uint64_t write_len;
 	uint64_t write_pos;
 
+	struct smart_run run = { 0 };
+
 	int rc = 0;
 
 	if (!buf || !bl) {
@@ -607,33 +649,67 @@ int blocklevel_smart_write(struct blocklevel_device *bl, uint64_t pos, const voi
 		}
 
 		rc = bl->read(bl, erase_block, erase_buf, erase_size);
-		if (rc)
+		if (rc) {
+			/* Don't lose blocks we'd already decided to write */
+			smart_run_flush(bl, &run);
 			goto out;
+		}
 
 		cmp = blocklevel_flashcmp(erase_buf + block_offset, write_buf,
 					  chunk_size);
 		FL_DBG("%s: region 0x%08x..0x%08x ", __func__,
 				erase_block, erase_size);
-		if (cmp != 0) {
-			FL_DBG("needs ");
+
+		if (cmp == 0) {
+			FL_DBG("clean\n");
+			rc = smart_run_flush(bl, &run);
+			if (rc)
+				goto out;
+			goto next;
+		}
+
+		FL_DBG("needs %swrite\n", cmp == -1 ? "erase and " : "");
+
+		if (chunk_size == erase_size) {
+			/* Start a new run or extend the current one */
+			if (!run.len) {
+				run.pos = erase_block;
+				run.buf = write_buf;
+			}
+			run.len += erase_size;
+
 			if (cmp == -1) {
-				FL_DBG("erase and ");
-				bl->erase(bl, erase_block, erase_size);
+				if (!run.erase_len)
+					run.erase_pos = erase_block;
+				run.erase_len = erase_block + erase_size -
+						run.erase_pos;
 			}
-			FL_DBG("write\n");
-			memcpy(erase_buf + block_offset, write_buf, chunk_size);
-			rc = bl->write(bl, erase_block, erase_buf, erase_size);
+			goto next;
+		}
+
+		/* Partial erase block, merge it with what is on the flash */
+		rc = smart_run_flush(bl, &run);
+		if (rc)
+			goto out;
+
+		if (cmp == -1) {
+			rc = bl->erase(bl, erase_block, erase_size);
 			if (rc)
 				goto out;
-		} else {
-			FL_DBG("clean\n");
 		}
+		memcpy(erase_buf + block_offset, write_buf, chunk_size);
+		rc = bl->write(bl, erase_block, erase_buf, erase_size);
+		if (rc)
+			goto out;
 
+next:
 		write_len -= chunk_size;
 		write_pos += chunk_size;
 		write_buf += chunk_size;
 	}
 
+	rc = smart_run_flush(bl, &run);
+
 out:
 	release(bl);
 out_free:
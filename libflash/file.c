@@ -8,6 +8,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -26,12 +27,74 @@ struct file_data {
 	int fd;
 	char *name;
 	char *path;
+	/*
+	 * Regular files kept alive are mapped so that reads are a memcpy()
+	 * rather than a syscall per chunk. Writes and erases only go through
+	 * the mapping once file_set_size() has allocated every block, a
+	 * store to a hole can't report ENOSPC, it raises SIGBUS. Anything
+	 * else goes through the file descriptor as before.
+	 */
+	uint8_t *map;
+	uint64_t map_size;
+	bool map_writable;
+	bool map_dirty;
 	struct blocklevel_device bl;
 };
 
+/*
+ * The mapping is shared so the page cache is always coherent with the
+ * fd, only release() (where someone else may be about to use the
+ * device) waits for the writeback.
+ */
+static void file_unmap(struct file_data *file_data, bool sync)
+{
+	if (!file_data->map)
+		return;
+
+	if (sync && file_data->map_dirty)
+		msync(file_data->map, file_data->map_size, MS_SYNC);
+	munmap(file_data->map, file_data->map_size);
+	file_data->map = NULL;
+	file_data->map_size = 0;
+	file_data->map_writable = false;
+	file_data->map_dirty = false;
+}
+
+static void file_map(struct file_data *file_data, bool writable)
+{
+	struct stat st;
+	void *map;
+
+	file_unmap(file_data, false);
+
+	if (fstat(file_data->fd, &st) || !S_ISREG(st.st_mode))
+		return;
+	if (!st.st_size || st.st_size > SIZE_MAX)
+		return;
+
+	map = mmap(NULL, st.st_size, PROT_READ | (writable ? PROT_WRITE : 0),
+		   MAP_SHARED, file_data->fd, 0);
+	if (map == MAP_FAILED) {
+		FL_DBG("%s: mmap failed, using read()/write(): %s\n",
+		       __func__, strerror(errno));
+		return;
+	}
+
+	file_data->map = map;
+	file_data->map_size = st.st_size;
+	file_data->map_writable = writable;
+}
+
+static bool file_mapped(struct file_data *file_data, uint64_t pos, uint64_t len)
+{
+	return file_data->map && pos <= file_data->map_size &&
+		len <= file_data->map_size - pos;
+}
+
 static int file_release(struct blocklevel_device *bl)
 {
 	struct file_data *file_data = container_of(bl, struct file_data, bl);
+	file_unmap(file_data, true);
 	close(file_data->fd);
 	file_data->fd = -1;
 	return 0;
@@ -54,6 +117,11 @@ static int file_read(struct blocklevel_device *bl, uint64_t pos, void *buf, uint
 	struct file_data *file_data = container_of(bl, struct file_data, bl);
 	int rc, count = 0;
 
+	if (file_mapped(file_data, pos, len)) {
+		memcpy(buf, file_data->map + pos, len);
+		return 0;
+	}
+
 	rc = lseek(file_data->fd, pos, SEEK_SET);
 	/* errno should remain set */
 	if (rc != pos)
@@ -78,6 +146,12 @@ static int file_write(struct blocklevel_device *bl, uint64_t dst, const void *sr
 	struct file_data *file_data = container_of(bl, struct file_data, bl);
 	int rc, count = 0;
 
+	if (file_data->map_writable && file_mapped(file_data, dst, len)) {
+		memcpy(file_data->map + dst, src, len);
+		file_data->map_dirty = true;
+		return 0;
+	}
+
 	rc = lseek(file_data->fd, dst, SEEK_SET);
 	/* errno should remain set */
 	if (rc != dst)
@@ -93,6 +167,13 @@ static int file_write(struct blocklevel_device *bl, uint64_t dst, const void *sr
 		count += rc;
 	}
 
+	/*
+	 * The file may have grown, map the whole thing again. Don't write
+	 * through it, the write may have left a hole.
+	 */
+	if (file_data->map && dst + len > file_data->map_size)
+		file_map(file_data, false);
+
 	return 0;
 }
 
@@ -105,10 +186,17 @@ static int file_write(struct blocklevel_device *bl, uint64_t dst, const void *sr
  */
 static int file_erase(struct blocklevel_device *bl, uint64_t dst, uint64_t len)
 {
+	struct file_data *file_data = container_of(bl, struct file_data, bl);
 	static char buf[4096];
 	int i = 0;
 	int rc;
 
+	if (file_data->map_writable && file_mapped(file_data, dst, len)) {
+		memset(file_data->map + dst, ~0, len);
+		file_data->map_dirty = true;
+		return 0;
+	}
+
 	memset(buf, ~0, sizeof(buf));
 
 	while (len - i > 0) {
@@ -309,7 +397,9 @@ int file_init(int fd, struct blocklevel_device **bl)
 		file_data->bl.flags = WRITE_NEED_ERASE;
 		mtd_get_info(&file_data->bl, NULL, NULL, &(file_data->bl.erase_mask));
 		file_data->bl.erase_mask--;
-	} else if (!S_ISREG(sbuf.st_mode)) {
+	} else if (S_ISREG(sbuf.st_mode)) {
+		file_map(file_data, false);
+	} else {
 		/* If not a char device or a regular file something went wrong */
 		goto out;
 	}
@@ -353,6 +443,10 @@ int file_init_path(const char *path, int *r_fd, bool keep_alive,
 	file_data->bl.keep_alive = keep_alive;
 	file_data->path = path_ptr;
 
+	/* The fd is reopened for each access, don't map it each time */
+	if (!keep_alive)
+		file_unmap(file_data, false);
+
 	if (r_fd)
 		*r_fd = fd;
 
@@ -363,12 +457,49 @@ out:
 	return rc;
 }
 
+int file_set_size(struct blocklevel_device *bl, uint64_t size)
+{
+	struct file_data *file_data;
+	struct stat st;
+	int rc;
+
+	if (!bl)
+		return FLASH_ERR_PARM_ERROR;
+
+	file_data = container_of(bl, struct file_data, bl);
+	if (fstat(file_data->fd, &st))
+		return FLASH_ERR_PARM_ERROR;
+
+	/* Nothing to do for MTD devices, their size is what it is */
+	if (!S_ISREG(st.st_mode))
+		return 0;
+
+	/*
+	 * Allocate every block rather than just growing the file, so that
+	 * a full disk is reported here and not as a SIGBUS from a store to
+	 * the mapping.
+	 */
+	if (size < st.st_size)
+		size = st.st_size;
+	rc = posix_fallocate(file_data->fd, 0, size);
+	if (rc) {
+		errno = rc;
+		return FLASH_ERR_PARM_ERROR;
+	}
+
+	if (file_data->bl.keep_alive)
+		file_map(file_data, true);
+
+	return 0;
+}
+
 void file_exit(struct blocklevel_device *bl)
 {
 	struct file_data *file_data;
 	if (bl) {
 		free(bl->ecc_prot.prot);
 		file_data = container_of(bl, struct file_data, bl);
+		file_unmap(file_data, false);
 		free(file_data->name);
 		free(file_data->path);
 		free(file_data);
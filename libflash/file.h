@@ -25,6 +25,14 @@ void file_exit(struct blocklevel_device *bl);
  */
 int file_init_path(const char *path, int *fd, bool keep_alive, struct blocklevel_device **bl);
 
+/*
+ * file_set_size() grows a regular file to at least size bytes and
+ * allocates all of its blocks, so that a device kept alive can serve
+ * the whole image, writes included, from a single mapping rather than
+ * through read() and write(). It does nothing for MTD devices.
+ */
+int file_set_size(struct blocklevel_device *bl, uint64_t size);
+
 /*
  * file_exit_close is a convenience wrapper which will close the open
  * file descriptor and call file_exit().
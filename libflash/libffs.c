@@ -23,6 +23,13 @@ struct ffs_handle {
 	/* The converted header knows how big this is */
 	struct __ffs_hdr *cache;
 	struct blocklevel_device *bl;
+	/*
+	 * Open addressed hash of partition names, each slot holds the
+	 * entry index plus one so zero is empty. NULL if the allocation
+	 * failed, lookups fall back to a scan.
+	 */
+	uint16_t		*index;
+	uint32_t		index_mask;
 };
 
 static uint32_t ffs_checksum(void* data, size_t size)
@@ -50,6 +57,50 @@ static size_t ffs_hdr_raw_size(int num_entries)
 	return sizeof(struct __ffs_hdr) + num_entries * sizeof(struct __ffs_entry);
 }
 
+/* Only as much of the name as ffs_lookup_part() compares */
+static uint32_t ffs_name_hash(const char *name)
+{
+	uint32_t hash = 2166136261u;
+	int i;
+
+	for (i = 0; i < FFS_PART_NAME_MAX && name[i]; i++)
+		hash = (hash ^ (uint8_t)name[i]) * 16777619u;
+
+	return hash;
+}
+
+static void ffs_build_index(struct ffs_handle *ffs)
+{
+	uint32_t size = 1, slot;
+	int i;
+
+	if (ffs->hdr.count >= UINT16_MAX)
+		return;
+
+	while (size < 2 * ffs->hdr.count)
+		size <<= 1;
+
+	ffs->index = calloc(size, sizeof(*ffs->index));
+	if (!ffs->index)
+		return;
+	ffs->index_mask = size - 1;
+
+	for (i = 0; i < ffs->hdr.count; i++) {
+		const char *name = ffs->hdr.entries[i]->name;
+
+		slot = ffs_name_hash(name) & ffs->index_mask;
+		while (ffs->index[slot]) {
+			/* Duplicate names resolve to the first, like a scan */
+			if (!strncmp(name, ffs->hdr.entries[ffs->index[slot] - 1]->name,
+				     FFS_PART_NAME_MAX))
+				break;
+			slot = (slot + 1) & ffs->index_mask;
+		}
+		if (!ffs->index[slot])
+			ffs->index[slot] = i + 1;
+	}
+}
+
 static int ffs_num_entries(struct ffs_hdr *hdr)
 {
 	if (hdr->count == 0)
@@ -420,6 +471,8 @@ int ffs_init(uint32_t offset, uint32_t max_size, struct blocklevel_device *bl,
 		}
 	}
 
+	ffs_build_index(f);
+
 out:
 	if (rc == 0)
 		*ffs = f;
@@ -429,6 +482,39 @@ out:
 	return rc;
 }
 
+bool ffs_toc_stale(struct ffs_handle *ffs)
+{
+	struct __ffs_hdr hdr;
+	uint32_t len;
+	void *raw;
+	bool stale;
+
+	if (!ffs || !ffs->cache)
+		return true;
+
+	/* A changed header, checksum included, is enough to tell */
+	if (blocklevel_read(ffs->bl, ffs->toc_offset, &hdr, sizeof(hdr)) ||
+	    memcmp(&hdr, ffs->cache, sizeof(hdr)) != 0)
+		return true;
+
+	/*
+	 * The header checksum only covers the header, entries can be
+	 * rewritten without touching it so compare them too. Each one
+	 * carries its own checksum.
+	 */
+	len = ffs->hdr.entries_size * sizeof(struct __ffs_entry);
+	raw = malloc(len);
+	if (!raw)
+		return true;
+
+	stale = blocklevel_read(ffs->bl, ffs->toc_offset + sizeof(hdr),
+				raw, len) ||
+		memcmp(raw, ffs->cache->entries, len) != 0;
+	free(raw);
+
+	return stale;
+}
+
 static void __hdr_free(struct ffs_hdr *hdr)
 {
 	int i;
@@ -454,6 +540,8 @@ void ffs_close(struct ffs_handle *ffs)
 	if (ffs->cache)
 		free(ffs->cache);
 
+	free(ffs->index);
+
 	free(ffs);
 }
 
@@ -461,8 +549,23 @@ int ffs_lookup_part(struct ffs_handle *ffs, const char *name,
 		    uint32_t *part_idx)
 {
 	struct ffs_entry **ents = ffs->hdr.entries;
+	uint32_t slot;
 	int i;
 
+	if (ffs->index) {
+		slot = ffs_name_hash(name) & ffs->index_mask;
+		while (ffs->index[slot]) {
+			i = ffs->index[slot] - 1;
+			if (!strncmp(name, ents[i]->name, FFS_PART_NAME_MAX)) {
+				if (part_idx)
+					*part_idx = i;
+				return 0;
+			}
+			slot = (slot + 1) & ffs->index_mask;
+		}
+		return FFS_ERR_PART_NOT_FOUND;
+	}
+
 	for (i = 0;
 			i < ffs->hdr.count &&
 			strncmp(name, ents[i]->name, FFS_PART_NAME_MAX);
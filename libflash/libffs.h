@@ -116,6 +116,16 @@ bool ffs_equal(struct ffs_handle *one, struct ffs_handle *two);
 
 void ffs_close(struct ffs_handle *ffs);
 
+/*
+ * Check if the TOC header and entries on flash still match the ones ffs
+ * was parsed from. A changed header is caught without reading the
+ * entries. Otherwise the entries are read and compared too, so an
+ * unchanged TOC costs close to the reads of a fresh ffs_init(), only
+ * the parsing is saved. Callers keeping a handle around can use it
+ * to decide if they need to re-open it.
+ */
+bool ffs_toc_stale(struct ffs_handle *ffs);
+
 int ffs_lookup_part(struct ffs_handle *ffs, const char *name,
 		    uint32_t *part_idx);
 
@@ -31,6 +31,12 @@
 
 #define MBOX_DEFAULT_TIMEOUT 3 /* seconds */
 
+/*
+ * How far beyond a sequential access we ask the BMC to map. The BMC is
+ * free to give us a smaller window, this is only a hint.
+ */
+#define MBOX_WINDOW_AHEAD 0x100000
+
 #define MSG_CREATE(init_command) { .command = init_command }
 
 struct mbox_flash_data;
@@ -52,6 +58,9 @@ struct mbox_flash_data {
 	struct blocklevel_device bl;
 	uint32_t total_size;
 	uint32_t erase_granule;
+	uint32_t read_next; /* Where the last read finished */
+	uint32_t write_next; /* Where the last write finished */
+	uint64_t round_trips;
 	int rc;
 	bool reboot;
 	bool pause;
@@ -262,6 +271,7 @@ static int msg_send(struct mbox_flash_data *mbox_flash, struct bmc_mbox_msg *msg
 		return FLASH_ERR_AGAIN;
 	mbox_flash->busy = true;
 	mbox_flash->rc = 0;
+	mbox_flash->round_trips++;
 	return bmc_mbox_enqueue(msg, timeout_sec);
 }
 
@@ -574,6 +584,34 @@ static int mbox_flash_flush(struct mbox_flash_data *mbox_flash)
 	return rc;
 }
 
+/*
+ * Make a range of the write window dirty and get the BMC to write it
+ * back. In V1 of the protocol WRITE_FLUSH carries the range itself and
+ * implicitly marks it dirty, so there is no need for a separate
+ * MARK_WRITE_DIRTY round trip. V2+ dropped the arguments from
+ * WRITE_FLUSH so both messages are required.
+ */
+static int mbox_flash_dirty_flush(struct mbox_flash_data *mbox_flash,
+				  uint64_t pos, uint64_t len)
+{
+	int rc;
+
+	if (!mbox_flash->write.open) {
+		prlog(PR_ERR, "Attempting to flush without an open write window\n");
+		return FLASH_ERR_DEVICE_GONE;
+	}
+
+	if (mbox_flash->version == 1)
+		return mbox_flash_mark_write(mbox_flash, pos, len,
+					     MBOX_C_WRITE_FLUSH);
+
+	rc = mbox_flash_dirty(mbox_flash, pos, len);
+	if (rc)
+		return rc;
+
+	return mbox_flash_flush(mbox_flash);
+}
+
 /* Is the current window able perform the complete operation */
 static bool mbox_window_valid(struct lpc_window *win, uint64_t pos,
 			      uint64_t len)
@@ -587,9 +625,37 @@ static bool mbox_window_valid(struct lpc_window *win, uint64_t pos,
 	return true;
 }
 
+/*
+ * Work out how many blocks to ask the BMC for when opening a window at
+ * pos. V1 windows have a fixed size. From V2 the size is only a hint,
+ * but one large enough to cover the whole access saves a window move
+ * (and a round trip to the BMC) for every default sized window the
+ * access would otherwise span. Don't ask for anything past the end of
+ * the flash, and leave it to the BMC if we don't know the size yet.
+ */
+static uint16_t mbox_window_hint(struct mbox_flash_data *mbox_flash,
+				 uint64_t pos, uint64_t want)
+{
+	uint64_t start = pos & ~mbox_flash_mask(mbox_flash);
+	uint64_t end = pos + want;
+
+	if (mbox_flash->version == 1 || !mbox_flash->total_size)
+		return 0;
+
+	if (end > mbox_flash->total_size)
+		end = mbox_flash->total_size;
+	if (end <= start)
+		return 0;
+
+	end = ALIGN_UP(end, 1ULL << mbox_flash->shift);
+
+	return MIN((end - start) >> mbox_flash->shift, (uint64_t)UINT16_MAX);
+}
+
 static int mbox_window_move(struct mbox_flash_data *mbox_flash,
 			    struct lpc_window *win, uint8_t command,
-			    uint64_t pos, uint64_t len, uint64_t *size)
+			    uint64_t pos, uint64_t len, uint64_t want,
+			    uint64_t *size)
 {
 	struct bmc_mbox_msg msg = MSG_CREATE(command);
 	int rc;
@@ -608,6 +674,7 @@ static int mbox_window_move(struct mbox_flash_data *mbox_flash,
 	win->cur_pos = pos & ~mbox_flash_mask(mbox_flash);
 
 	msg_put_u16(&msg, 0, bytes_to_blocks(mbox_flash, pos));
+	msg_put_u16(&msg, 2, mbox_window_hint(mbox_flash, pos, want));
 	rc = msg_send(mbox_flash, &msg, mbox_flash->timeout);
 	if (rc) {
 		prlog(PR_ERR, "Failed to enqueue/send BMC MBOX message\n");
@@ -658,7 +725,7 @@ static int mbox_flash_write(struct blocklevel_device *bl, uint64_t pos,
 			    const void *buf, uint64_t len)
 {
 	struct mbox_flash_data *mbox_flash;
-	uint64_t size;
+	uint64_t size, want;
 
 	int rc = 0;
 
@@ -671,12 +738,17 @@ static int mbox_flash_write(struct blocklevel_device *bl, uint64_t pos,
 	if (do_delayed_work(mbox_flash))
 		return FLASH_ERR_AGAIN;
 
+	/* Same as for reads, see mbox_flash_read() */
+	want = len;
+	if (pos == mbox_flash->write_next)
+		want += MBOX_WINDOW_AHEAD;
+
 	prlog(PR_TRACE, "Flash write at %#" PRIx64 " for %#" PRIx64 "\n", pos, len);
 	while (len > 0) {
 		/* Move window and get a new size to read */
 		rc = mbox_window_move(mbox_flash, &mbox_flash->write,
 				      MBOX_C_CREATE_WRITE_WINDOW, pos, len,
-				      &size);
+				      want, &size);
 		if (rc)
 			return rc;
 
@@ -685,10 +757,6 @@ static int mbox_flash_write(struct blocklevel_device *bl, uint64_t pos,
 		if (rc)
 			return rc;
 
-		rc = mbox_flash_dirty(mbox_flash, pos, size);
-		if (rc)
-			return rc;
-
 		/*
 		 * Must flush here as changing the window contents
 		 * without flushing entitles the BMC to throw away the
@@ -696,14 +764,16 @@ static int mbox_flash_write(struct blocklevel_device *bl, uint64_t pos,
 		 * validate the window, the flush command will fail if the
 		 * window was compromised.
 		 */
-		rc = mbox_flash_flush(mbox_flash);
+		rc = mbox_flash_dirty_flush(mbox_flash, pos, size);
 		if (rc)
 			return rc;
 
 		len -= size;
 		pos += size;
 		buf += size;
+		want -= size;
 	}
+	mbox_flash->write_next = pos;
 	return rc;
 }
 
@@ -711,7 +781,7 @@ static int mbox_flash_read(struct blocklevel_device *bl, uint64_t pos,
 			   void *buf, uint64_t len)
 {
 	struct mbox_flash_data *mbox_flash;
-	uint64_t size;
+	uint64_t size, want;
 
 	int rc = 0;
 
@@ -724,12 +794,21 @@ static int mbox_flash_read(struct blocklevel_device *bl, uint64_t pos,
 	if (do_delayed_work(mbox_flash))
 		return FLASH_ERR_AGAIN;
 
+	/*
+	 * Reads which carry on from where the last one finished are
+	 * likely to keep going (partition scans, ECC reads, pflash dumps),
+	 * ask for a window that covers some of what comes next too.
+	 */
+	want = len;
+	if (pos == mbox_flash->read_next)
+		want += MBOX_WINDOW_AHEAD;
+
 	prlog(PR_TRACE, "Flash read at %#" PRIx64 " for %#" PRIx64 "\n", pos, len);
 	while (len > 0) {
 		/* Move window and get a new size to read */
 		rc = mbox_window_move(mbox_flash, &mbox_flash->read,
 				      MBOX_C_CREATE_READ_WINDOW, pos,
-				      len, &size);
+				      len, want, &size);
 		if (rc)
 			return rc;
 
@@ -741,6 +820,7 @@ static int mbox_flash_read(struct blocklevel_device *bl, uint64_t pos,
 		len -= size;
 		pos += size;
 		buf += size;
+		want -= size;
 		/*
 		 * Ensure my window is still open, if it isn't we can't trust
 		 * what we read
@@ -748,6 +828,7 @@ static int mbox_flash_read(struct blocklevel_device *bl, uint64_t pos,
 		if (!is_valid(mbox_flash, &mbox_flash->read))
 			return FLASH_ERR_AGAIN;
 	}
+	mbox_flash->read_next = pos;
 	return rc;
 }
 
@@ -834,7 +915,8 @@ static int mbox_flash_erase_v2(struct blocklevel_device *bl, uint64_t pos,
 
 		/* Move window and get a new size to erase */
 		rc = mbox_window_move(mbox_flash, &mbox_flash->write,
-				      MBOX_C_CREATE_WRITE_WINDOW, pos, len, &size);
+				      MBOX_C_CREATE_WRITE_WINDOW, pos, len, len,
+				      &size);
 		if (rc)
 			return rc;
 
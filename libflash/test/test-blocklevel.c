@@ -113,6 +113,211 @@ static void print_ptr(void *ptr, int len)
 	putchar('\n');
 }
 
+/*
+ * A larger synthetic flash for blocklevel_smart_write(), counting the
+ * operations that reach the backend.
+ */
+#define BIG_SIZE	0x1000000
+#define BIG_ERASE	0x10000
+#define BIG_BLOCKS	(BIG_SIZE / BIG_ERASE)
+
+static struct {
+	uint8_t *flash;
+	unsigned int reads;
+	unsigned int writes;
+	unsigned int erases;
+} big;
+
+static int bl_big_read(struct blocklevel_device *bl __unused, uint64_t pos, void *buf, uint64_t len)
+{
+	if (pos + len > BIG_SIZE)
+		return FLASH_ERR_PARM_ERROR;
+
+	big.reads++;
+	memcpy(buf, big.flash + pos, len);
+
+	return 0;
+}
+
+static int bl_big_write(struct blocklevel_device *bl __unused, uint64_t pos, const void *buf, uint64_t len)
+{
+	const uint8_t *b = buf;
+	uint64_t i;
+
+	if (pos + len > BIG_SIZE)
+		return FLASH_ERR_PARM_ERROR;
+
+	/* Like real flash, writes can only clear bits */
+	big.writes++;
+	for (i = 0; i < len; i++)
+		big.flash[pos + i] &= b[i];
+
+	return 0;
+}
+
+static int bl_big_erase(struct blocklevel_device *bl __unused, uint64_t pos, uint64_t len)
+{
+	if (pos + len > BIG_SIZE || pos % BIG_ERASE || len % BIG_ERASE)
+		return FLASH_ERR_PARM_ERROR;
+
+	big.erases++;
+	memset(big.flash + pos, 0xff, len);
+
+	return 0;
+}
+
+static int bl_big_get_info(struct blocklevel_device *bl __unused, const char **name,
+		uint64_t *total_size, uint32_t *erase_granule)
+{
+	if (name)
+		*name = NULL;
+	if (total_size)
+		*total_size = BIG_SIZE;
+	if (erase_granule)
+		*erase_granule = BIG_ERASE;
+
+	return 0;
+}
+
+static void big_reset_counts(void)
+{
+	big.reads = big.writes = big.erases = 0;
+}
+
+static int big_check(const char *what, const uint8_t *image, unsigned int reads,
+		unsigned int writes, unsigned int erases)
+{
+	printf("%s: %u reads, %u writes, %u erases\n", what, big.reads,
+			big.writes, big.erases);
+
+	if (memcmp(big.flash, image, BIG_SIZE)) {
+		ERR("%s: flash doesn't match the image\n", what);
+		return 1;
+	}
+	if (big.reads != reads || big.writes != writes || big.erases != erases) {
+		ERR("%s: expected %u reads, %u writes, %u erases\n", what,
+				reads, writes, erases);
+		return 1;
+	}
+
+	return 0;
+}
+
+static int test_smart_write(void)
+{
+	struct blocklevel_device bl_big = {
+		.read = bl_big_read,
+		.write = bl_big_write,
+		.erase = bl_big_erase,
+		.get_info = bl_big_get_info,
+		.erase_mask = BIG_ERASE - 1,
+		.flags = WRITE_NEED_ERASE,
+	};
+	struct blocklevel_device *bl = &bl_big;
+	uint8_t *image, check[0x100];
+	int i, rc = 1;
+
+	big.flash = malloc(BIG_SIZE);
+	image = malloc(BIG_SIZE);
+	if (!big.flash || !image) {
+		ERR("malloc failed\n");
+		goto out;
+	}
+
+	memset(big.flash, 0xff, BIG_SIZE);
+	for (i = 0; i < BIG_SIZE; i++)
+		image[i] = (i * 7 + (i >> 16)) & 0xfe;
+
+	/* Blank flash: every block is read, nothing needs erasing */
+	big_reset_counts();
+	if (blocklevel_smart_write(bl, 0, image, BIG_SIZE)) {
+		ERR("blocklevel_smart_write() of the whole image failed\n");
+		goto out;
+	}
+	if (big_check("blank flash", image, BIG_BLOCKS, 1, 0))
+		goto out;
+
+	/* Rewriting the same image reads it all back and writes nothing */
+	big_reset_counts();
+	if (blocklevel_smart_write(bl, 0, image, BIG_SIZE)) {
+		ERR("blocklevel_smart_write() of the same image failed\n");
+		goto out;
+	}
+	if (big_check("same image", image, BIG_BLOCKS, 0, 0))
+		goto out;
+
+	/*
+	 * Set bits in ten contiguous blocks, clear bits in another, both
+	 * runs are batched into a single erase/write.
+	 */
+	for (i = 10 * BIG_ERASE; i < 20 * BIG_ERASE; i++)
+		image[i] |= 1;
+	for (i = 40 * BIG_ERASE; i < 41 * BIG_ERASE; i++)
+		image[i] &= 0x0f;
+	big_reset_counts();
+	if (blocklevel_smart_write(bl, 0, image, BIG_SIZE)) {
+		ERR("blocklevel_smart_write() of a modified image failed\n");
+		goto out;
+	}
+	if (big_check("modified image", image, BIG_BLOCKS, 2, 1))
+		goto out;
+
+	/* An unaligned write across a block boundary still merges */
+	memset(image + 3 * BIG_ERASE - 0x80, 0x5a, 0x100);
+	big_reset_counts();
+	if (blocklevel_smart_write(bl, 3 * BIG_ERASE - 0x80,
+				image + 3 * BIG_ERASE - 0x80, 0x100)) {
+		ERR("blocklevel_smart_write() across a boundary failed\n");
+		goto out;
+	}
+	if (big_check("unaligned write", image, 2, 2, 2))
+		goto out;
+
+	/* A block a plain write changed is put back */
+	memset(image + 5 * BIG_ERASE, 0, BIG_ERASE);
+	if (blocklevel_write(bl, 5 * BIG_ERASE, image + 5 * BIG_ERASE, BIG_ERASE)) {
+		ERR("blocklevel_write() failed\n");
+		goto out;
+	}
+	memset(image + 5 * BIG_ERASE, 0xa5, BIG_ERASE);
+	big_reset_counts();
+	if (blocklevel_smart_write(bl, 0, image, BIG_SIZE)) {
+		ERR("blocklevel_smart_write() after a plain write failed\n");
+		goto out;
+	}
+	if (big_check("after plain write", image, BIG_BLOCKS, 1, 1))
+		goto out;
+
+	/* And through ECC */
+	if (blocklevel_ecc_protect(bl, 8 * BIG_ERASE, 2 * BIG_ERASE)) {
+		ERR("blocklevel_ecc_protect() failed\n");
+		goto out;
+	}
+	memset(check, 0x3c, sizeof(check));
+	if (blocklevel_smart_write(bl, 8 * BIG_ERASE + 0x40, check, sizeof(check))) {
+		ERR("blocklevel_smart_write() with ECC failed\n");
+		goto out;
+	}
+	memset(check, 0, sizeof(check));
+	if (blocklevel_read(bl, 8 * BIG_ERASE + 0x40, check, sizeof(check))) {
+		ERR("blocklevel_read() with ECC failed\n");
+		goto out;
+	}
+	for (i = 0; i < sizeof(check); i++) {
+		if (check[i] != 0x3c) {
+			ERR("ECC smart write read back mismatch at %d\n", i);
+			goto out;
+		}
+	}
+
+	rc = 0;
+out:
+	free(bl->ecc_prot.prot);
+	free(big.flash);
+	free(image);
+	return rc;
+}
+
 int main(void)
 {
 	struct blocklevel_device bl_mem = { 0 };
@@ -657,6 +862,8 @@ int main(void)
 		goto out;
 	}
 
+	rc = test_smart_write();
+
 out:
 	free(buf);
 	free(data);
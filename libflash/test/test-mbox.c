@@ -271,6 +271,76 @@ out:
 	return rc;
 }
 
+/*
+ * Every message to the BMC is a round trip, count how many it takes to
+ * move data sequentially through the flash in small pieces, which is
+ * roughly what the ffs and ECC code do.
+ */
+#define ROUND_TRIP_CHUNK 0x1000
+#define ROUND_TRIP_MAX_SIZE 0x400000
+
+static int run_round_trip_test(struct blocklevel_device *bl)
+{
+	struct mbox_flash_data *mbox_flash;
+	uint64_t start, size, pos;
+	unsigned int chunks;
+	char *buf;
+	int rc = 0;
+
+	mbox_flash = container_of(bl, struct mbox_flash_data, bl);
+
+	size = MIN(mbox_server_total_size(), ROUND_TRIP_MAX_SIZE);
+	chunks = size / ROUND_TRIP_CHUNK;
+
+	buf = malloc(ROUND_TRIP_CHUNK);
+	if (!buf) {
+		ERR("malloc failed\n");
+		return 1;
+	}
+
+	start = mbox_flash->round_trips;
+	for (pos = 0; pos < size; pos += ROUND_TRIP_CHUNK) {
+		rc = blocklevel_read(bl, pos, buf, ROUND_TRIP_CHUNK);
+		if (rc) {
+			ERR("blocklevel_read(0x%08lx, 0x%08x) failed with err %d\n",
+					pos, ROUND_TRIP_CHUNK, rc);
+			goto out;
+		}
+	}
+	printf("V%d sequential read: %lu round trips for %u reads (%lu per MB)\n",
+			mbox_flash->version, mbox_flash->round_trips - start,
+			chunks, (mbox_flash->round_trips - start) * 0x100000 / size);
+
+	/* V1 windows are fixed size, there's nothing to read ahead with */
+	if (mbox_flash->version > 1 && mbox_flash->round_trips - start >= chunks) {
+		ERR("Sequential reads didn't make use of read ahead\n");
+		rc = 1;
+		goto out;
+	}
+
+	memset(buf, 0x5a, ROUND_TRIP_CHUNK);
+	start = mbox_flash->round_trips;
+	for (pos = 0; pos < size; pos += ROUND_TRIP_CHUNK) {
+		rc = blocklevel_write(bl, pos, buf, ROUND_TRIP_CHUNK);
+		if (rc) {
+			ERR("blocklevel_write(0x%08lx, 0x%08x) failed with err %d\n",
+					pos, ROUND_TRIP_CHUNK, rc);
+			goto out;
+		}
+	}
+	printf("V%d sequential write: %lu round trips for %u writes (%lu per MB)\n",
+			mbox_flash->version, mbox_flash->round_trips - start,
+			chunks, (mbox_flash->round_trips - start) * 0x100000 / size);
+
+	if (mbox_server_memcmp(size - ROUND_TRIP_CHUNK, buf, ROUND_TRIP_CHUNK)) {
+		ERR("Sequential write mismatch!\n");
+		rc = 1;
+	}
+out:
+	free(buf);
+	return rc;
+}
+
 int main(void)
 {
 	struct blocklevel_device *bl;
@@ -292,6 +362,9 @@ int main(void)
 	/* run test */
 	mbox_flash_init(&bl);
 	rc = run_flash_test(bl);
+	if (rc)
+		goto out;
+	rc = run_round_trip_test(bl);
 	if (rc)
 		goto out;
 	/*
@@ -305,6 +378,9 @@ int main(void)
 
 	/* Do all the tests again */
 	rc = run_flash_test(bl);
+	if (rc)
+		goto out;
+	rc = run_round_trip_test(bl);
 	if (rc)
 		goto out;
 
@@ -314,6 +390,9 @@ int main(void)
 	rc = run_flash_test(bl);
 	if (rc)
 		goto out;
+	rc = run_round_trip_test(bl);
+	if (rc)
+		goto out;
 
 
 	printf("Doing mbox-flash V3 tests\n");
@@ -322,7 +401,9 @@ int main(void)
 
 	/* Do all the tests again */
 	rc = run_flash_test(bl);
-
+	if (rc)
+		goto out;
+	rc = run_round_trip_test(bl);
 
 out:
 	mbox_flash_exit(bl);